@@ -0,0 +1,265 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include "Benchmark.h"
+
+#include <OpenThreads/Barrier>
+#include <OpenThreads/Clock>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Version>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace Bench;
+
+//-----------------------------------------------------------------------------
+// Results and context
+//
+
+double Result::nsPerOp() const
+{
+	return operations > 0 ? (seconds * 1e9) / (double)operations : 0.0;
+}
+
+double Result::opsPerSec() const
+{
+	return seconds > 0.0 ? (double)operations / seconds : 0.0;
+}
+
+Context::Context()
+	: _maxThreads(1), _scale(1.0)
+{
+	int n = OpenThreads::GetNumberOfProcessors();
+	setMaxThreads(n > 1 ? (unsigned int)n : 2);
+}
+
+std::vector<unsigned int> Context::getThreadCounts(unsigned int minThreads) const
+{
+	std::vector<unsigned int> counts;
+	unsigned int n = minThreads > 0 ? minThreads : 1;
+	for (; n < _maxThreads; n *= 2)
+		counts.push_back(n);
+	counts.push_back(_maxThreads > minThreads ? _maxThreads : minThreads);
+	return counts;
+}
+
+unsigned long long Context::iterations(unsigned long long nominal) const
+{
+	unsigned long long n = (unsigned long long)((double)nominal * _scale);
+	return n > 0 ? n : 1;
+}
+
+void Context::report(const std::string& name, unsigned int threads, unsigned long long operations, double seconds)
+{
+	Result r;
+	r.name = name;
+	r.threads = threads;
+	r.operations = operations;
+	r.seconds = seconds;
+	_results.push_back(r);
+
+	std::cerr << "  " << name << " [" << threads << " thread" << (threads > 1 ? "s" : "") << "] "
+		<< r.nsPerOp() << " ns/op" << std::endl;
+}
+
+void Timer::start()
+{
+	_start = (double)OpenThreads::Clock::nanoseconds() * 1e-9;
+}
+
+double Timer::elapsed() const
+{
+	return (double)OpenThreads::Clock::nanoseconds() * 1e-9 - _start;
+}
+
+//-----------------------------------------------------------------------------
+// Thread helper
+//
+
+namespace {
+
+class BodyThread : public OpenThreads::Thread
+{
+public:
+	BodyThread(const std::function<void(unsigned int)>& body, unsigned int index, OpenThreads::Barrier& barrier)
+		: _body(body), _index(index), _barrier(barrier) {}
+
+	virtual void run()
+	{
+		_barrier.block();
+		_body(_index);
+	}
+
+private:
+	const std::function<void(unsigned int)>& _body;
+	unsigned int _index;
+	OpenThreads::Barrier& _barrier;
+};
+
+}
+
+double Bench::runThreads(unsigned int count, const std::function<void(unsigned int)>& body)
+{
+	OpenThreads::Barrier barrier(count + 1);
+	std::vector<std::unique_ptr<BodyThread> > threads;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		threads.push_back(std::unique_ptr<BodyThread>(new BodyThread(body, i, barrier)));
+		threads.back()->start();
+	}
+
+	// Start timing before the release: on a busy machine the workers may
+	// well run to completion before this thread is scheduled again.
+	Timer timer;
+	barrier.block();
+	for (unsigned int i = 0; i < count; ++i)
+		threads[i]->join();
+	return timer.elapsed();
+}
+
+//-----------------------------------------------------------------------------
+// Registry
+//
+
+namespace {
+
+struct Entry
+{
+	const char* name;
+	Function function;
+};
+
+std::vector<Entry>& registry()
+{
+	static std::vector<Entry> s_entries;
+	return s_entries;
+}
+
+std::string escape(const std::string& s)
+{
+	std::string out;
+	for (std::string::const_iterator it = s.begin(); it != s.end(); ++it)
+	{
+		if (*it == '"' || *it == '\\')
+			out += '\\';
+		out += *it;
+	}
+	return out;
+}
+
+void writeJson(std::ostream& os, const Context& ctxt)
+{
+	os << "{\n";
+	os << "  \"library\": \"" << escape(OpenThreadsGetLibraryName()) << "\",\n";
+	os << "  \"version\": \"" << escape(OpenThreadsGetVersion()) << "\",\n";
+	os << "  \"timestamp\": " << (unsigned long long)time(NULL) << ",\n";
+	os << "  \"processors\": " << OpenThreads::GetNumberOfProcessors() << ",\n";
+	os << "  \"max_threads\": " << ctxt.getMaxThreads() << ",\n";
+	os << "  \"scale\": " << ctxt.getScale() << ",\n";
+	os << "  \"results\": [";
+
+	const std::vector<Result>& results = ctxt.getResults();
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result& r = results[i];
+		os << (i == 0 ? "\n" : ",\n");
+		os << "    {\"name\": \"" << escape(r.name) << "\""
+			<< ", \"threads\": " << r.threads
+			<< ", \"operations\": " << r.operations
+			<< ", \"seconds\": " << r.seconds
+			<< ", \"ns_per_op\": " << r.nsPerOp()
+			<< ", \"ops_per_sec\": " << r.opsPerSec() << "}";
+	}
+	os << "\n  ]\n}\n";
+}
+
+void usage(const char* argv0)
+{
+	std::cerr << "Usage: " << argv0 << " [--threads N] [--scale X] [--filter NAME] [--output FILE] [--list]" << std::endl;
+}
+
+}
+
+Register::Register(const char* name, Function function)
+{
+	Entry e = { name, function };
+	registry().push_back(e);
+}
+
+int main(int argc, char** argv)
+{
+	Context ctxt;
+	std::string filter, output;
+	bool list = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc)
+			ctxt.setMaxThreads((unsigned int)atoi(argv[++i]));
+		else if (arg == "--scale" && i + 1 < argc)
+			ctxt.setScale(atof(argv[++i]));
+		else if (arg == "--filter" && i + 1 < argc)
+			filter = argv[++i];
+		else if (arg == "--output" && i + 1 < argc)
+			output = argv[++i];
+		else if (arg == "--list")
+			list = true;
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	OpenThreads::Thread::Init();
+
+	std::vector<Entry>& entries = registry();
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (!filter.empty() && strstr(entries[i].name, filter.c_str()) == NULL)
+			continue;
+		if (list)
+		{
+			std::cout << entries[i].name << std::endl;
+			continue;
+		}
+		std::cerr << entries[i].name << std::endl;
+		entries[i].function(ctxt);
+	}
+
+	if (list)
+		return 0;
+
+	if (output.empty())
+	{
+		writeJson(std::cout, ctxt);
+	}
+	else
+	{
+		std::ofstream file(output.c_str());
+		if (!file)
+		{
+			std::cerr << "Cannot open " << output << " for writing" << std::endl;
+			return 1;
+		}
+		writeJson(file, ctxt);
+	}
+	return 0;
+}
@@ -0,0 +1,98 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+
+//
+// Benchmark - Minimal harness for the OpenThreads benchmark suite
+// ~~~~~~~~~
+//
+
+#ifndef _OPENTHREADS_BENCHMARK_
+#define _OPENTHREADS_BENCHMARK_
+
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace Bench {
+
+// One measurement: 'operations' operations performed by 'threads' threads
+// in 'seconds' seconds (wall clock).
+struct Result
+{
+	std::string name;
+	unsigned int threads;
+	unsigned long long operations;
+	double seconds;
+
+	double nsPerOp() const;
+	double opsPerSec() const;
+};
+
+class Context
+{
+public:
+	Context();
+
+	// Highest thread count to measure contended benchmarks with.
+	unsigned int getMaxThreads() const { return _maxThreads; }
+	void setMaxThreads(unsigned int n) { _maxThreads = n > 0 ? n : 1; }
+
+	// 1, 2, 4, ... up to getMaxThreads() (always included).
+	std::vector<unsigned int> getThreadCounts(unsigned int minThreads = 1) const;
+
+	// Multiplier applied to the nominal iteration count of each benchmark.
+	double getScale() const { return _scale; }
+	void setScale(double scale) { _scale = scale; }
+	unsigned long long iterations(unsigned long long nominal) const;
+
+	void report(const std::string& name, unsigned int threads, unsigned long long operations, double seconds);
+	const std::vector<Result>& getResults() const { return _results; }
+
+private:
+	unsigned int _maxThreads;
+	double _scale;
+	std::vector<Result> _results;
+};
+
+// Wall clock stopwatch, in seconds.
+class Timer
+{
+public:
+	Timer() { start(); }
+	void start();
+	double elapsed() const;
+private:
+	double _start;
+};
+
+// Runs body(index) on 'count' OpenThreads::Thread instances released
+// together, and returns the wall time between the release and the last
+// thread finishing.
+double runThreads(unsigned int count, const std::function<void(unsigned int)>& body);
+
+// Benchmarks register themselves at static initialization time.
+typedef void (*Function)(Context& ctxt);
+
+class Register
+{
+public:
+	Register(const char* name, Function function);
+};
+
+}
+
+#define OPENTHREADS_BENCHMARK(name, function) \
+	static Bench::Register s_register_##function(name, &function)
+
+#endif // !_OPENTHREADS_BENCHMARK_
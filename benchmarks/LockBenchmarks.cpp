@@ -0,0 +1,62 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+//
+// Compares the lock types usable with ScopedLock on the same short
+// critical section, from 1 to N threads.
+//
+
+#include "Benchmark.h"
+
+#include <OpenThreads/Mutex>
+#include <OpenThreads/QueueMutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/SpinMutex>
+
+#include <string>
+
+using namespace OpenThreads;
+
+namespace {
+
+template <class M>
+void runLock(Bench::Context& ctxt, const std::string& name)
+{
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		M mutex;
+		volatile unsigned long long shared = 0;
+		unsigned long long n = ctxt.iterations(500000);
+		double seconds = Bench::runThreads(counts[c], [&](unsigned int) {
+			for (unsigned long long i = 0; i < n; ++i)
+			{
+				ScopedLock<M> lock(mutex);
+				shared = shared + 1;
+			}
+		});
+		ctxt.report(name, counts[c], n * counts[c], seconds);
+	}
+}
+
+void benchLocks(Bench::Context& ctxt)
+{
+	runLock<Mutex>(ctxt, "lock.mutex");
+	runLock<QueueMutex>(ctxt, "lock.queuemutex");
+	runLock<SpinMutex>(ctxt, "lock.spinmutex");
+	runLock<TicketSpinMutex>(ctxt, "lock.ticketspinmutex");
+}
+
+}
+
+OPENTHREADS_BENCHMARK("lock", benchLocks);
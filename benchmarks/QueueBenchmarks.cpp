@@ -0,0 +1,245 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+//
+// Throughput of the queues that pass items between threads (SpscRing and
+// Channel), against a std::deque guarded by a Mutex and a Condition, and of
+// an SpscRing drained by a PollerThread.
+//
+
+#include "Benchmark.h"
+
+#include <OpenThreads/Channel>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/PollerThread>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/SpscRing>
+
+#include <atomic>
+#include <deque>
+
+using namespace OpenThreads;
+
+namespace {
+
+// The baseline: what producer/consumer code does without the ring.
+class LockedQueue
+{
+public:
+	void push(unsigned long long v)
+	{
+		ScopedLock<Mutex> lock(_mutex);
+		_items.push_back(v);
+		_condition.signal();
+	}
+
+	unsigned long long pop()
+	{
+		ScopedLock<Mutex> lock(_mutex);
+		while (_items.empty())
+			_condition.wait(&_mutex);
+		unsigned long long v = _items.front();
+		_items.pop_front();
+		return v;
+	}
+
+private:
+	Mutex _mutex;
+	Condition _condition;
+	std::deque<unsigned long long> _items;
+};
+
+void benchSpsc(Bench::Context& ctxt)
+{
+	unsigned long long n = ctxt.iterations(2000000);
+
+	{
+		LockedQueue queue;
+		unsigned long long sum = 0;
+		double seconds = Bench::runThreads(2, [&](unsigned int index) {
+			if (index == 0)
+			{
+				for (unsigned long long i = 0; i < n; ++i)
+					queue.push(i);
+			}
+			else
+			{
+				for (unsigned long long i = 0; i < n; ++i)
+					sum += queue.pop();
+			}
+		});
+		ctxt.report("spsc.mutexcondition", 2, n, seconds);
+	}
+
+	{
+		SpscRing<unsigned long long> ring(1024);
+		unsigned long long sum = 0;
+		double seconds = Bench::runThreads(2, [&](unsigned int index) {
+			if (index == 0)
+			{
+				for (unsigned long long i = 0; i < n; ++i)
+					ring.push(i);
+			}
+			else
+			{
+				unsigned long long v = 0;
+				for (unsigned long long i = 0; i < n; ++i)
+				{
+					ring.pop(v);
+					sum += v;
+				}
+			}
+		});
+		ctxt.report("spsc.ring", 2, n, seconds);
+	}
+
+	{
+		const size_t BATCH = 64;
+		SpscRing<unsigned long long> ring(1024);
+		unsigned long long sum = 0;
+		double seconds = Bench::runThreads(2, [&](unsigned int index) {
+			unsigned long long items[BATCH];
+			if (index == 0)
+			{
+				for (unsigned long long i = 0; i < n; )
+				{
+					size_t count = 0;
+					for (; count < BATCH && i + count < n; ++count)
+						items[count] = i + count;
+					size_t pushed = 0;
+					while (pushed < count)
+					{
+						size_t m = ring.tryPushBatch(items + pushed, count - pushed);
+						if (m == 0)
+							Thread::YieldCurrentThread();
+						pushed += m;
+					}
+					i += count;
+				}
+			}
+			else
+			{
+				for (unsigned long long i = 0; i < n; )
+				{
+					size_t count = ring.popBatch(items, BATCH);
+					for (size_t k = 0; k < count; ++k)
+						sum += items[k];
+					i += count;
+				}
+			}
+		});
+		ctxt.report("spsc.ring.batch", 2, n, seconds);
+	}
+}
+
+class RingSource : public PollSource
+{
+public:
+	RingSource(SpscRing<unsigned long long>& ring) : _ring(ring), _sum(0), _count(0) {}
+
+	virtual unsigned int poll()
+	{
+		unsigned int n = 0;
+		unsigned long long v;
+		while (_ring.tryPop(v))
+		{
+			_sum += v;
+			++n;
+		}
+		_count.store(_count.load(std::memory_order_relaxed) + n, std::memory_order_release);
+		return n;
+	}
+
+	unsigned long long getCount() const { return _count.load(std::memory_order_acquire); }
+
+private:
+	SpscRing<unsigned long long>& _ring;
+	unsigned long long _sum;
+	std::atomic<unsigned long long> _count;
+};
+
+// Items pushed to an SpscRing and notified to a PollerThread that spins for
+// ever, then to one allowed to park after 50 us without items
+void benchPoller(Bench::Context& ctxt)
+{
+	unsigned long long n = ctxt.iterations(1000000);
+	for (int parking = 0; parking < 2; ++parking)
+	{
+		SpscRing<unsigned long long> ring(1024);
+		RingSource source(ring);
+		PollerThread poller;
+		poller.addSource(&source);
+		poller.setParkAfter(parking ? 50 : 0);
+		poller.start();
+
+		Bench::Timer timer;
+		for (unsigned long long i = 0; i < n; ++i)
+		{
+			while (!ring.tryPush(i))
+				Thread::YieldCurrentThread();
+			poller.notify();
+		}
+		while (source.getCount() < n)
+			Thread::YieldCurrentThread();
+		ctxt.report(parking ? "poller.park" : "poller.spin", 2, n, timer.elapsed());
+
+		poller.stop();
+		poller.join();
+	}
+}
+
+// N producers and N consumers; each consumer takes as many items as a
+// producer sends.
+void benchChannel(Bench::Context& ctxt)
+{
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	unsigned long long n = ctxt.iterations(500000);
+
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		LockedQueue queue;
+		double seconds = Bench::runThreads(2 * counts[c], [&](unsigned int index) {
+			for (unsigned long long i = 0; i < n; ++i)
+			{
+				if (index < counts[c])
+					queue.push(i);
+				else
+					queue.pop();
+			}
+		});
+		ctxt.report("channel.mutexcondition", 2 * counts[c], n * counts[c], seconds);
+	}
+
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		Channel<unsigned long long> channel(1024);
+		double seconds = Bench::runThreads(2 * counts[c], [&](unsigned int index) {
+			unsigned long long v;
+			for (unsigned long long i = 0; i < n; ++i)
+			{
+				if (index < counts[c])
+					channel.send(i);
+				else
+					channel.recv(v);
+			}
+		});
+		ctxt.report("channel.mpmc", 2 * counts[c], n * counts[c], seconds);
+	}
+}
+
+}
+
+OPENTHREADS_BENCHMARK("spsc", benchSpsc);
+OPENTHREADS_BENCHMARK("channel", benchChannel);
+OPENTHREADS_BENCHMARK("poller", benchPoller);
@@ -0,0 +1,105 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+//
+// Readers of a table published through an AtomicPtr, protected by the
+// memory reclamation schemes, with and without a thread swapping the table.
+//
+
+#include "Benchmark.h"
+
+#include <OpenThreads/Atomic>
+#include <OpenThreads/EpochDomain>
+#include <OpenThreads/HazardDomain>
+
+#include <string>
+
+using namespace OpenThreads;
+
+namespace {
+
+struct Table
+{
+	explicit Table(int v) { for (int i = 0; i < 4; ++i) values[i] = v; }
+	int values[4];
+};
+
+// Each scheme reads one value of the current table and retires old tables.
+struct EpochScheme
+{
+	int read(const AtomicPtr& current, unsigned long long i)
+	{
+		EpochGuard guard(domain);
+		return static_cast<const Table*>(current.get())->values[i & 3];
+	}
+	void retire(Table* table) { domain.retire(table); }
+
+	EpochDomain domain;
+};
+
+struct HazardScheme
+{
+	int read(const AtomicPtr& current, unsigned long long i)
+	{
+		HazardPointer hp(domain);
+		return static_cast<const Table*>(hp.protect(current))->values[i & 3];
+	}
+	void retire(Table* table) { domain.retire(table); }
+
+	HazardDomain domain;
+};
+
+template <class Scheme>
+void runScheme(Bench::Context& ctxt, const std::string& name)
+{
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	for (int writer = 0; writer < 2; ++writer)
+	{
+		for (size_t c = 0; c < counts.size(); ++c)
+		{
+			Scheme scheme;
+			AtomicPtr current(new Table(0));
+			Atomic sink, done;
+			unsigned long long n = ctxt.iterations(1000000);
+			double seconds = Bench::runThreads(counts[c] + writer, [&](unsigned int index) {
+				if (index == counts[c])
+				{
+					for (int v = 1; done != counts[c]; ++v)
+					{
+						Table* old = static_cast<Table*>(current.get());
+						if (current.assign(new Table(v), old))
+							scheme.retire(old);
+					}
+					return;
+				}
+				int sum = 0;
+				for (unsigned long long i = 0; i < n; ++i)
+					sum += scheme.read(current, i);
+				sink.exchange((unsigned)sum);
+				++done;
+			});
+			ctxt.report(writer ? name + ".writer" : name, counts[c], n * counts[c], seconds);
+			delete static_cast<Table*>(current.get());
+		}
+	}
+}
+
+void benchReclaim(Bench::Context& ctxt)
+{
+	runScheme<EpochScheme>(ctxt, "epoch.read");
+	runScheme<HazardScheme>(ctxt, "hazard.read");
+}
+
+}
+
+OPENTHREADS_BENCHMARK("reclaim", benchReclaim);
@@ -0,0 +1,285 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+//
+// Benchmarks for the synchronization primitives: Mutex, Condition, Barrier,
+// Block, Atomic, and ReadWriteMutex against SeqLock for read-mostly data.
+//
+
+#include "Benchmark.h"
+
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Barrier>
+#include <OpenThreads/Block>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ReadWriteMutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/SeqLock>
+
+using namespace OpenThreads;
+
+namespace {
+
+void benchMutex(Bench::Context& ctxt)
+{
+	{
+		Mutex mutex;
+		unsigned long long n = ctxt.iterations(10000000);
+		Bench::Timer timer;
+		for (unsigned long long i = 0; i < n; ++i)
+		{
+			mutex.lock();
+			mutex.unlock();
+		}
+		ctxt.report("mutex.uncontended", 1, n, timer.elapsed());
+	}
+
+	std::vector<unsigned int> counts = ctxt.getThreadCounts(2);
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		Mutex mutex;
+		volatile unsigned long long shared = 0;
+		unsigned long long n = ctxt.iterations(1000000);
+		double seconds = Bench::runThreads(counts[c], [&](unsigned int) {
+			for (unsigned long long i = 0; i < n; ++i)
+			{
+				ScopedLock<Mutex> lock(mutex);
+				shared = shared + 1;
+			}
+		});
+		ctxt.report("mutex.contended", counts[c], n * counts[c], seconds);
+	}
+}
+
+void benchCondition(Bench::Context& ctxt)
+{
+	// Two threads hand a token back and forth; one operation is a round trip.
+	Mutex mutex;
+	Condition condition;
+	unsigned int turn = 0;
+	unsigned long long n = ctxt.iterations(100000);
+
+	double seconds = Bench::runThreads(2, [&](unsigned int index) {
+		ScopedLock<Mutex> lock(mutex);
+		for (unsigned long long i = 0; i < n; ++i)
+		{
+			while (turn != index)
+				condition.wait(&mutex);
+			turn = 1 - index;
+			condition.signal();
+		}
+	});
+	ctxt.report("condition.pingpong", 2, n, seconds);
+}
+
+void benchBarrier(Bench::Context& ctxt)
+{
+	std::vector<unsigned int> counts = ctxt.getThreadCounts(2);
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		Barrier barrier(counts[c]);
+		unsigned long long n = ctxt.iterations(20000);
+		double seconds = Bench::runThreads(counts[c], [&](unsigned int) {
+			for (unsigned long long i = 0; i < n; ++i)
+				barrier.block();
+		});
+		ctxt.report("barrier.phase", counts[c], n, seconds);
+	}
+}
+
+void benchBlock(Bench::Context& ctxt)
+{
+	// Each side releases the other's block then waits on its own: the
+	// operation time is the latency of a release plus a wake-up.
+	Block blocks[2];
+	unsigned long long n = ctxt.iterations(100000);
+
+	double seconds = Bench::runThreads(2, [&](unsigned int index) {
+		Block& mine = blocks[index];
+		Block& other = blocks[1 - index];
+		for (unsigned long long i = 0; i < n; ++i)
+		{
+			if (index == 0)
+				other.release();
+			mine.block();
+			mine.reset();
+			if (index == 1)
+				other.release();
+		}
+	});
+	ctxt.report("block.release", 2, n * 2, seconds);
+}
+
+void benchAtomic(Bench::Context& ctxt)
+{
+	{
+		Atomic value;
+		unsigned long long n = ctxt.iterations(20000000);
+		Bench::Timer timer;
+		for (unsigned long long i = 0; i < n; ++i)
+			++value;
+		ctxt.report("atomic.increment", 1, n, timer.elapsed());
+	}
+
+	{
+		Atomic value;
+		unsigned long long n = ctxt.iterations(20000000);
+		Bench::Timer timer;
+		for (unsigned long long i = 0; i < n; ++i)
+			value.exchange((unsigned)i);
+		ctxt.report("atomic.exchange", 1, n, timer.elapsed());
+	}
+
+	{
+		Atomic value;
+		unsigned long long n = ctxt.iterations(20000000);
+		volatile unsigned sink = 0;
+		Bench::Timer timer;
+		for (unsigned long long i = 0; i < n; ++i)
+			sink = (unsigned)value;
+		ctxt.report("atomic.read", 1, n, timer.elapsed());
+		(void)sink;
+	}
+
+	{
+		int a = 0, b = 0;
+		AtomicPtr ptr(&a);
+		unsigned long long n = ctxt.iterations(20000000);
+		Bench::Timer timer;
+		for (unsigned long long i = 0; i < n; ++i)
+		{
+			if (!ptr.assign(&b, &a))
+				break;
+			ptr.assign(&a, &b);
+		}
+		ctxt.report("atomicptr.assign", 1, n * 2, timer.elapsed());
+	}
+
+	std::vector<unsigned int> counts = ctxt.getThreadCounts(2);
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		Atomic value;
+		unsigned long long n = ctxt.iterations(2000000);
+		double seconds = Bench::runThreads(counts[c], [&](unsigned int) {
+			for (unsigned long long i = 0; i < n; ++i)
+				++value;
+		});
+		ctxt.report("atomic.increment.contended", counts[c], n * counts[c], seconds);
+	}
+}
+
+void benchReadWriteMutex(Bench::Context& ctxt)
+{
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		ReadWriteMutex mutex;
+		int shared[4] = { 1, 2, 3, 4 };
+		Atomic sink;
+		unsigned long long n = ctxt.iterations(500000);
+		double seconds = Bench::runThreads(counts[c], [&](unsigned int) {
+			int sum = 0;
+			for (unsigned long long i = 0; i < n; ++i)
+			{
+				ScopedReadLock lock(mutex);
+				sum += shared[i & 3];
+			}
+			sink.exchange((unsigned)sum);
+		});
+		ctxt.report("rwmutex.read", counts[c], n * counts[c], seconds);
+	}
+
+	// Readers with one thread continuously writing, the counterpart of
+	// seqlock.read.writer.
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		ReadWriteMutex mutex;
+		int shared[4] = { 1, 2, 3, 4 };
+		Atomic sink, done;
+		unsigned long long n = ctxt.iterations(500000);
+		double seconds = Bench::runThreads(counts[c] + 1, [&](unsigned int index) {
+			if (index == counts[c])
+			{
+				for (int v = 0; done != counts[c]; ++v)
+				{
+					ScopedWriteLock lock(mutex);
+					for (int i = 0; i < 4; ++i)
+						shared[i] = v;
+				}
+				return;
+			}
+			int sum = 0;
+			for (unsigned long long i = 0; i < n; ++i)
+			{
+				ScopedReadLock lock(mutex);
+				sum += shared[i & 3];
+			}
+			sink.exchange((unsigned)sum);
+			++done;
+		});
+		ctxt.report("rwmutex.read.writer", counts[c], n * counts[c], seconds);
+	}
+
+	// The same snapshot behind a SeqLock: readers do not write shared state.
+	struct Snapshot { int values[4]; };
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		Snapshot initial = { { 1, 2, 3, 4 } };
+		SeqLock<Snapshot> seqlock(initial);
+		Atomic sink;
+		unsigned long long n = ctxt.iterations(500000);
+		double seconds = Bench::runThreads(counts[c], [&](unsigned int) {
+			int sum = 0;
+			for (unsigned long long i = 0; i < n; ++i)
+				sum += seqlock.read().values[i & 3];
+			sink.exchange((unsigned)sum);
+		});
+		ctxt.report("seqlock.read", counts[c], n * counts[c], seconds);
+	}
+
+	// Readers with one thread continuously writing.
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		Snapshot initial = { { 1, 2, 3, 4 } };
+		SeqLock<Snapshot> seqlock(initial);
+		Atomic sink, done;
+		unsigned long long n = ctxt.iterations(500000);
+		double seconds = Bench::runThreads(counts[c] + 1, [&](unsigned int index) {
+			if (index == counts[c])
+			{
+				for (int v = 0; done != counts[c]; ++v)
+				{
+					Snapshot s = { { v, v, v, v } };
+					seqlock.write(s);
+				}
+				return;
+			}
+			int sum = 0;
+			for (unsigned long long i = 0; i < n; ++i)
+				sum += seqlock.read().values[i & 3];
+			sink.exchange((unsigned)sum);
+			++done;
+		});
+		ctxt.report("seqlock.read.writer", counts[c], n * counts[c], seconds);
+	}
+}
+
+}
+
+OPENTHREADS_BENCHMARK("mutex", benchMutex);
+OPENTHREADS_BENCHMARK("condition", benchCondition);
+OPENTHREADS_BENCHMARK("barrier", benchBarrier);
+OPENTHREADS_BENCHMARK("block", benchBlock);
+OPENTHREADS_BENCHMARK("atomic", benchAtomic);
+OPENTHREADS_BENCHMARK("rwmutex", benchReadWriteMutex);
@@ -0,0 +1,697 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+//
+// Benchmarks for Thread creation, clocks, the ThreadPool, its timers and
+// Pipeline.
+//
+
+#include "Benchmark.h"
+
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Barrier>
+#include <OpenThreads/Block>
+#include <OpenThreads/Clock>
+#include <OpenThreads/ObjectPool>
+#include <OpenThreads/Thread>
+#include <OpenThreads/ThreadArena>
+#include <OpenThreads/ThreadLocal>
+#ifdef _OPENTHREADS_USE_THREAD_POOL
+#include <OpenThreads/Coroutine>
+#include <OpenThreads/Fiber>
+#include <OpenThreads/ForkJoin>
+#include <OpenThreads/Pipeline>
+#include <OpenThreads/Strand>
+#include <OpenThreads/TaskGroup>
+#include <OpenThreads/ThreadPool>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+using namespace OpenThreads;
+
+namespace {
+
+class EmptyThread : public Thread
+{
+public:
+	virtual void run() {}
+};
+
+void benchThreadStartJoin(Bench::Context& ctxt)
+{
+	unsigned long long n = ctxt.iterations(2000);
+	Bench::Timer timer;
+	for (unsigned long long i = 0; i < n; ++i)
+	{
+		EmptyThread thread;
+		thread.start();
+		thread.join();
+	}
+	ctxt.report("thread.start_join", 1, n, timer.elapsed());
+}
+
+// Cost of reading the time
+void benchClock(Bench::Context& ctxt)
+{
+	unsigned long long n = ctxt.iterations(5000000);
+	volatile unsigned long long sink = 0;
+	Bench::Timer timer;
+	for (unsigned long long i = 0; i < n; ++i)
+		sink = Thread::getTickCount();
+	ctxt.report("clock.gettickcount", 1, n, timer.elapsed());
+
+	timer.start();
+	for (unsigned long long i = 0; i < n; ++i)
+		sink = Clock::nanoseconds();
+	ctxt.report("clock.nanoseconds", 1, n, timer.elapsed());
+
+	timer.start();
+	for (unsigned long long i = 0; i < n; ++i)
+		sink = Clock::cycles();
+	ctxt.report("clock.cycles", 1, n, timer.elapsed());
+	(void)sink;
+}
+
+// Each thread allocates blocks of mixed sizes, then frees those the next
+// thread allocated, as queues of tasks or messages between threads do
+class AllocatingThread : public Thread
+{
+public:
+	AllocatingThread(std::vector<void*>& mine, std::vector<void*>& theirs, Barrier& barrier, bool pooled, unsigned long long rounds)
+		: _mine(mine), _theirs(theirs), _barrier(barrier), _pooled(pooled), _rounds(rounds) {}
+
+	static size_t getSize(size_t i) { return 32 + (i * 37) % 480; }
+
+	virtual void run()
+	{
+		for (unsigned long long r = 0; r < _rounds; ++r)
+		{
+			for (size_t i = 0; i < _mine.size(); ++i)
+				_mine[i] = _pooled ? TaskAllocator::allocate(getSize(i)) : ::operator new(getSize(i));
+			_barrier.block();
+			for (size_t i = 0; i < _theirs.size(); ++i)
+			{
+				if (_pooled)
+					TaskAllocator::deallocate(_theirs[i], getSize(i));
+				else
+					::operator delete(_theirs[i]);
+			}
+			_barrier.block();
+		}
+	}
+
+private:
+	std::vector<void*>& _mine;
+	std::vector<void*>& _theirs;
+	Barrier& _barrier;
+	bool _pooled;
+	unsigned long long _rounds;
+};
+
+void benchAllocator(Bench::Context& ctxt)
+{
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		for (int pooled = 1; pooled >= 0; --pooled)
+		{
+			unsigned long long rounds = ctxt.iterations(200);
+			std::vector<std::vector<void*> > blocks(counts[c], std::vector<void*>(1024));
+			Barrier barrier(counts[c]);
+			std::vector<std::unique_ptr<AllocatingThread> > threads;
+			for (unsigned int i = 0; i < counts[c]; ++i)
+				threads.push_back(std::unique_ptr<AllocatingThread>(new AllocatingThread(blocks[i], blocks[(i + 1) % counts[c]], barrier, pooled != 0, rounds)));
+
+			Bench::Timer timer;
+			for (size_t i = 0; i < threads.size(); ++i)
+				threads[i]->start();
+			for (size_t i = 0; i < threads.size(); ++i)
+				threads[i]->join();
+			ctxt.report(pooled ? "allocator.task_allocator" : "allocator.heap", counts[c], rounds * 1024 * counts[c], timer.elapsed());
+		}
+	}
+}
+
+// A frame's worth of temporary buffers of mixed sizes, freed all at once
+// at the end of the frame
+void benchArena(Bench::Context& ctxt)
+{
+	const size_t buffers = 256;
+	unsigned long long frames = ctxt.iterations(20000);
+	std::vector<void*> frame(buffers);
+
+	ThreadArena arena;
+	Bench::Timer timer;
+	for (unsigned long long f = 0; f < frames; ++f)
+	{
+		for (size_t i = 0; i < buffers; ++i)
+		{
+			frame[i] = arena.allocate(AllocatingThread::getSize(i));
+			static_cast<char*>(frame[i])[0] = (char)i;
+		}
+		arena.reset();
+	}
+	ctxt.report("arena.reset", 1, frames * buffers, timer.elapsed());
+
+	timer.start();
+	for (unsigned long long f = 0; f < frames; ++f)
+	{
+		for (size_t i = 0; i < buffers; ++i)
+		{
+			frame[i] = ::operator new(AllocatingThread::getSize(i));
+			static_cast<char*>(frame[i])[0] = (char)i;
+		}
+		for (size_t i = 0; i < buffers; ++i)
+			::operator delete(frame[i]);
+	}
+	ctxt.report("arena.heap", 1, frames * buffers, timer.elapsed());
+}
+
+// Threads counting events: in a counter of their own combined at the end,
+// against a shared atomic counter
+void benchThreadLocal(Bench::Context& ctxt)
+{
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		unsigned long long n = ctxt.iterations(2000000);
+
+		ThreadLocal<unsigned long long> local(0);
+		double seconds = Bench::runThreads(counts[c], [&](unsigned int) {
+			for (unsigned long long i = 0; i < n; ++i)
+				++local.local();
+		});
+		ctxt.report("threadlocal.local", counts[c], n * counts[c], seconds);
+
+		std::atomic<unsigned long long> shared(0);
+		seconds = Bench::runThreads(counts[c], [&](unsigned int) {
+			for (unsigned long long i = 0; i < n; ++i)
+				shared.fetch_add(1, std::memory_order_relaxed);
+		});
+		ctxt.report("threadlocal.atomic", counts[c], n * counts[c], seconds);
+	}
+}
+
+#ifdef _OPENTHREADS_USE_THREAD_POOL
+
+// A task that does nothing but count down; the last one releases the block.
+class CountingTask : public OpenThreads::Task
+{
+public:
+	CountingTask(Atomic& remaining, Block& done) : _remaining(remaining), _done(done) {}
+
+	virtual void execute(TaskContext&)
+	{
+		if (--_remaining == 0)
+			_done.release();
+	}
+
+private:
+	Atomic& _remaining;
+	Block& _done;
+};
+
+void runPool(Bench::Context& ctxt, const char* name, unsigned int numWorkers, ThreadPool::DispatchOp* dispatch)
+{
+	std::vector<std::unique_ptr<WorkerThread> > workers;
+	ThreadPool pool(dispatch);
+	for (unsigned int i = 0; i < numWorkers; ++i)
+	{
+		workers.push_back(std::unique_ptr<WorkerThread>(new WorkerThread));
+		pool.add(workers.back().get());
+	}
+
+	unsigned long long n = ctxt.iterations(200000);
+	Atomic remaining((unsigned)n);
+	Block done;
+	std::vector<CountingTask> tasks(n, CountingTask(remaining, done));
+	// For DispatchKeyAffinity; the other dispatchers ignore them
+	for (unsigned long long i = 0; i < n; ++i)
+		tasks[i].setAffinityKey(i % 64 + 1);
+
+	Bench::Timer timer;
+	for (unsigned long long i = 0; i < n; ++i)
+		pool.submit(&tasks[i]);
+	done.block();
+	ctxt.report(name, numWorkers, n, timer.elapsed());
+
+	pool.stop();
+}
+
+// Adding idle workers to a pool, then stopping it
+void runStartStop(Bench::Context& ctxt, unsigned int numWorkers)
+{
+	unsigned long long n = ctxt.iterations(200);
+	Bench::Timer timer;
+	for (unsigned long long i = 0; i < n; ++i)
+	{
+		std::vector<std::unique_ptr<WorkerThread> > workers;
+		ThreadPool pool;
+		for (unsigned int w = 0; w < numWorkers; ++w)
+		{
+			workers.push_back(std::unique_ptr<WorkerThread>(new WorkerThread));
+			pool.add(workers.back().get());
+		}
+		pool.stop();
+	}
+	ctxt.report("threadpool.start_stop", numWorkers, n, timer.elapsed());
+}
+
+// Cost of polling for cancellation in a task's loop
+class PollingTask : public OpenThreads::Task
+{
+public:
+	PollingTask(Bench::Context& ctxt, Block& done) : _ctxt(ctxt), _done(done) {}
+
+	virtual void execute(TaskContext& taskContext)
+	{
+		unsigned long long n = _ctxt.iterations(10000000), polls = 0;
+		Bench::Timer timer;
+		for (unsigned long long i = 0; i < n; ++i)
+		{
+			if (taskContext.shouldStop())
+				break;
+			++polls;
+		}
+		_ctxt.report("threadpool.shouldstop", 1, polls, timer.elapsed());
+		_done.release();
+	}
+
+private:
+	Bench::Context& _ctxt;
+	Block& _done;
+};
+
+void runShouldStop(Bench::Context& ctxt)
+{
+	WorkerThread worker;
+	ThreadPool pool;
+	pool.add(&worker);
+
+	CancellationToken token;
+	Block done;
+	PollingTask task(ctxt, done);
+	task.setCancellationToken(&token);
+	pool.submit(&task);
+	done.block();
+
+	pool.stop();
+}
+
+void benchThreadPool(Bench::Context& ctxt)
+{
+	runShouldStop(ctxt);
+
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		runPool(ctxt, "threadpool.submit.dummy", counts[c], new ThreadPool::DispatchDummy);
+		runPool(ctxt, "threadpool.submit.roundrobin", counts[c], new ThreadPool::DispatchRoundRobin);
+		runPool(ctxt, "threadpool.submit.leastloaded", counts[c], new ThreadPool::DispatchLeastLoaded);
+		runPool(ctxt, "threadpool.submit.twochoices", counts[c], new ThreadPool::DispatchPowerOfTwoChoices);
+		runPool(ctxt, "threadpool.submit.affinity", counts[c], new ThreadPool::DispatchKeyAffinity);
+		runStartStop(ctxt, counts[c]);
+	}
+}
+
+// Items through a serial input, a parallel stage and an in-order output.
+void benchPipeline(Bench::Context& ctxt)
+{
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		std::vector<std::unique_ptr<WorkerThread> > workers;
+		ThreadPool pool(new ThreadPool::DispatchRoundRobin);
+		for (unsigned int i = 0; i < counts[c]; ++i)
+		{
+			workers.push_back(std::unique_ptr<WorkerThread>(new WorkerThread));
+			pool.add(workers.back().get());
+		}
+
+		unsigned long long n = ctxt.iterations(100000), produced = 0;
+		std::vector<unsigned long long> items(n);
+		unsigned long long sum = 0;
+
+		Pipeline pipeline(pool);
+		pipeline.add(PipelineStage::SERIAL_IN_ORDER, [&](void*) -> void* {
+			if (produced == n)
+				return nullptr;
+			items[produced] = produced;
+			return &items[produced++];
+		});
+		pipeline.add(PipelineStage::PARALLEL, [](void* item) -> void* {
+			unsigned long long* v = static_cast<unsigned long long*>(item);
+			for (int i = 0; i < 100; ++i)
+				*v = *v * 6364136223846793005ULL + 1442695040888963407ULL;
+			return item;
+		});
+		pipeline.add(PipelineStage::SERIAL_IN_ORDER, [&](void* item) -> void* {
+			sum += *static_cast<unsigned long long*>(item);
+			return nullptr;
+		});
+
+		Bench::Timer timer;
+		pipeline.run(4 * counts[c]);
+		ctxt.report("pipeline.3stages", counts[c], n, timer.elapsed());
+
+		pool.stop();
+	}
+}
+
+// Many pending timers: scheduling them all, spread over 20 ms, then waiting
+// for every one to fire; and scheduling then cancelling them.
+void benchTimers(Bench::Context& ctxt)
+{
+	WorkerThread worker;
+	ThreadPool pool;
+	pool.add(&worker);
+
+	unsigned long long n = ctxt.iterations(50000);
+	Atomic remaining((unsigned)n);
+	Block done;
+	std::vector<CountingTask> tasks(n, CountingTask(remaining, done));
+	// For DispatchKeyAffinity; the other dispatchers ignore them
+	for (unsigned long long i = 0; i < n; ++i)
+		tasks[i].setAffinityKey(i % 64 + 1);
+
+	Bench::Timer timer;
+	for (unsigned long long i = 0; i < n; ++i)
+		pool.schedule(&tasks[i], (i * 7919) % 20000);
+	done.block();
+	ctxt.report("timer.schedule_fire", 1, n, timer.elapsed());
+
+	std::vector<ThreadPool::TimerId> ids(n);
+	timer.start();
+	for (unsigned long long i = 0; i < n; ++i)
+		ids[i] = pool.schedule(&tasks[i], 1000000 + (i * 7919) % 20000000);
+	for (unsigned long long i = 0; i < n; ++i)
+		pool.cancel(ids[i]);
+	ctxt.report("timer.schedule_cancel", 1, n, timer.elapsed());
+
+	pool.stop();
+}
+
+// Recursive fibonacci, each call above the cutoff a group of two tasks
+// waited for by the task that created it.
+unsigned long long fibGroups(ThreadPool& pool, unsigned int n, Atomic& groups)
+{
+	if (n < 10)
+		return n < 2 ? n : fibGroups(pool, n - 1, groups) + fibGroups(pool, n - 2, groups);
+
+	unsigned long long a = 0, b = 0;
+	TaskGroup group(pool);
+	group.run([&](TaskContext&) { a = fibGroups(pool, n - 1, groups); });
+	group.run([&](TaskContext&) { b = fibGroups(pool, n - 2, groups); });
+	group.wait();
+	++groups;
+	return a + b;
+}
+
+void benchTaskGroup(Bench::Context& ctxt)
+{
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		std::vector<std::unique_ptr<WorkerThread> > workers;
+		ThreadPool pool(new ThreadPool::DispatchRoundRobin);
+		for (unsigned int i = 0; i < counts[c]; ++i)
+		{
+			workers.push_back(std::unique_ptr<WorkerThread>(new WorkerThread));
+			pool.add(workers.back().get());
+		}
+
+		unsigned long long n = ctxt.iterations(20);
+		Atomic groups;
+		Bench::Timer timer;
+		for (unsigned long long i = 0; i < n; ++i)
+			fibGroups(pool, 24, groups);
+		// Two tasks per group
+		ctxt.report("taskgroup.fib", counts[c], 2ULL * (unsigned)groups, timer.elapsed());
+
+		pool.stop();
+	}
+}
+
+// Tasks of 16 keys, each run in order: through a strand per key, which
+// may run on any worker, and pinned to workers by DispatchKeyAffinity
+void benchStrand(Bench::Context& ctxt)
+{
+	const unsigned int KEYS = 16;
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		std::vector<std::unique_ptr<WorkerThread> > workers;
+		ThreadPool pool(new ThreadPool::DispatchRoundRobin);
+		for (unsigned int i = 0; i < counts[c]; ++i)
+		{
+			workers.push_back(std::unique_ptr<WorkerThread>(new WorkerThread));
+			pool.add(workers.back().get());
+		}
+
+		unsigned long long n = ctxt.iterations(200000);
+		Atomic remaining((unsigned)n);
+		Block done;
+		std::vector<CountingTask> tasks(n, CountingTask(remaining, done));
+		std::vector<std::unique_ptr<Strand> > strands;
+		for (unsigned int k = 0; k < KEYS; ++k)
+			strands.push_back(std::unique_ptr<Strand>(new Strand(pool)));
+
+		Bench::Timer timer;
+		for (unsigned long long i = 0; i < n; ++i)
+			strands[i % KEYS]->post(&tasks[i]);
+		done.block();
+		ctxt.report("strand.post", counts[c], n, timer.elapsed());
+
+		ThreadPool::DispatchKeyAffinity affinity;
+		remaining.exchange((unsigned)n);
+		done.reset();
+		timer.start();
+		for (unsigned long long i = 0; i < n; ++i)
+		{
+			tasks[i].setAffinityKey(i % KEYS + 1);
+			pool.submit(&tasks[i], &affinity);
+		}
+		done.block();
+		ctxt.report("strand.affinity", counts[c], n, timer.elapsed());
+
+		for (unsigned int k = 0; k < KEYS; ++k)
+			strands[k]->wait();
+		pool.stop();
+	}
+}
+
+// Recursive fibonacci and quicksort split down to leaves of about a
+// microsecond, spawning on the workers' deques
+unsigned long long fibSpawn(unsigned int n)
+{
+	if (n < 2)
+		return n;
+	if (n < 12)
+		return fibSpawn(n - 1) + fibSpawn(n - 2);
+
+	unsigned long long a = 0, b = 0;
+	ForkJoin::invoke([&] { a = fibSpawn(n - 1); }, [&] { b = fibSpawn(n - 2); });
+	return a + b;
+}
+
+void quicksortSpawn(unsigned int* begin, unsigned int* end)
+{
+	if (end - begin < 256)
+	{
+		std::sort(begin, end);
+		return;
+	}
+
+	unsigned int pivot = begin[(end - begin) / 2];
+	unsigned int* less = std::partition(begin, end, [pivot](unsigned int x) { return x < pivot; });
+	unsigned int* greater = std::partition(less, end, [pivot](unsigned int x) { return !(pivot < x); });
+	ForkJoin::invoke([&] { quicksortSpawn(begin, less); }, [&] { quicksortSpawn(greater, end); });
+}
+
+void benchForkJoin(Bench::Context& ctxt)
+{
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		std::vector<std::unique_ptr<WorkerThread> > workers;
+		ThreadPool pool;
+		for (unsigned int i = 0; i < counts[c]; ++i)
+		{
+			workers.push_back(std::unique_ptr<WorkerThread>(new WorkerThread));
+			pool.add(workers.back().get());
+		}
+
+		// fib(n) makes 2 fib(n + 1) - 1 calls; report the time per call
+		unsigned long long n = ctxt.iterations(10), result = 0;
+		Bench::Timer timer;
+		for (unsigned long long i = 0; i < n; ++i)
+			ForkJoin::run(pool, [&] { result += fibSpawn(27); });
+		ctxt.report("forkjoin.fib", counts[c], n * (317811ULL * 2 - 1), timer.elapsed());
+
+		// Time per element sorted
+		std::vector<unsigned int> items((size_t)ctxt.iterations(1000000));
+		unsigned int x = 1;
+		for (size_t i = 0; i < items.size(); ++i)
+		{
+			x = x * 1664525 + 1013904223;
+			items[i] = x >> 8;
+		}
+		timer.start();
+		ForkJoin::run(pool, [&] { quicksortSpawn(items.data(), items.data() + items.size()); });
+		ctxt.report("forkjoin.quicksort", counts[c], items.size(), timer.elapsed());
+
+		pool.stop();
+	}
+}
+
+// Fibers waiting on a Block, which suspends them rather than their worker
+class BlockedFiber : public Task
+{
+public:
+	BlockedFiber(Block& gate, BlockCount& done) : _gate(gate), _done(done) {}
+
+	virtual void execute(TaskContext&)
+	{
+		_gate.block();
+		_done.completed();
+	}
+
+private:
+	Block& _gate;
+	BlockCount& _done;
+};
+
+void benchFiber(Bench::Context& ctxt)
+{
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		std::vector<std::unique_ptr<WorkerThread> > workers;
+		ThreadPool pool;
+		for (unsigned int i = 0; i < counts[c]; ++i)
+		{
+			workers.push_back(std::unique_ptr<WorkerThread>(new WorkerThread));
+			pool.add(workers.back().get());
+		}
+
+		// Time per fiber started, suspended, resumed and finished, with many
+		// more fibers waiting at once than there are workers
+		unsigned int n = (unsigned int)ctxt.iterations(10000);
+		Block gate;
+		BlockCount done(n);
+		done.reset();
+		std::vector<std::unique_ptr<BlockedFiber> > tasks;
+		for (unsigned int i = 0; i < n; ++i)
+			tasks.push_back(std::unique_ptr<BlockedFiber>(new BlockedFiber(gate, done)));
+		Bench::Timer timer;
+		for (unsigned int i = 0; i < n; ++i)
+			if (!Fiber::submit(pool, tasks[i].get()))
+				done.completed();
+		gate.release();
+		done.block();
+		ctxt.report("fiber.block", counts[c], n, timer.elapsed());
+
+		pool.stop();
+	}
+}
+
+#ifdef OPENTHREADS_HAS_COROUTINES
+Coroutine<unsigned int> coroutineLeaf(unsigned int i)
+{
+	co_return i & 1;
+}
+
+// Starts and awaits n coroutines in turn, their frames being recycled
+Coroutine<unsigned int> coroutineCalls(ThreadPool& pool, unsigned long long n)
+{
+	co_await pool.schedule();
+	unsigned int sum = 0;
+	for (unsigned long long i = 0; i < n; ++i)
+		sum += co_await coroutineLeaf((unsigned int)i);
+	co_return sum;
+}
+
+Coroutine<void> coroutineSend(Channel<unsigned int>& channel, unsigned long long n)
+{
+	for (unsigned long long i = 0; i < n; ++i)
+		co_await channel.sendAsync((unsigned int)i);
+	channel.close();
+}
+
+Coroutine<unsigned long long> coroutineRecv(ThreadPool& pool, Channel<unsigned int>& channel)
+{
+	co_await pool.schedule();
+	unsigned long long count = 0;
+	while (co_await channel.recvAsync())
+		++count;
+	co_return count;
+}
+
+void benchCoroutine(Bench::Context& ctxt)
+{
+	std::vector<unsigned int> counts = ctxt.getThreadCounts();
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		std::vector<std::unique_ptr<WorkerThread> > workers;
+		ThreadPool pool;
+		for (unsigned int i = 0; i < counts[c]; ++i)
+		{
+			workers.push_back(std::unique_ptr<WorkerThread>(new WorkerThread));
+			pool.add(workers.back().get());
+		}
+
+		unsigned long long n = ctxt.iterations(1000000);
+		Bench::Timer timer;
+		syncWait(coroutineCalls(pool, n));
+		ctxt.report("coroutine.call", counts[c], n, timer.elapsed());
+
+		// Items passed from a coroutine to another through a small channel,
+		// suspending both sides in turn
+		n = ctxt.iterations(100000);
+		Channel<unsigned int> channel(16);
+		timer.start();
+		spawn(pool, coroutineSend(channel, n));
+		syncWait(coroutineRecv(pool, channel));
+		ctxt.report("coroutine.channel", counts[c], n, timer.elapsed());
+
+		pool.stop();
+	}
+}
+#endif // OPENTHREADS_HAS_COROUTINES
+
+#endif // _OPENTHREADS_USE_THREAD_POOL
+
+}
+
+OPENTHREADS_BENCHMARK("thread", benchThreadStartJoin);
+OPENTHREADS_BENCHMARK("clock", benchClock);
+OPENTHREADS_BENCHMARK("allocator", benchAllocator);
+OPENTHREADS_BENCHMARK("arena", benchArena);
+OPENTHREADS_BENCHMARK("threadlocal", benchThreadLocal);
+#ifdef _OPENTHREADS_USE_THREAD_POOL
+OPENTHREADS_BENCHMARK("threadpool", benchThreadPool);
+OPENTHREADS_BENCHMARK("pipeline", benchPipeline);
+OPENTHREADS_BENCHMARK("timer", benchTimers);
+OPENTHREADS_BENCHMARK("taskgroup", benchTaskGroup);
+OPENTHREADS_BENCHMARK("strand", benchStrand);
+OPENTHREADS_BENCHMARK("forkjoin", benchForkJoin);
+OPENTHREADS_BENCHMARK("fiber", benchFiber);
+#ifdef OPENTHREADS_HAS_COROUTINES
+OPENTHREADS_BENCHMARK("coroutine", benchCoroutine);
+#endif
+#endif
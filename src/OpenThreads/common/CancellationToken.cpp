@@ -0,0 +1,105 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/CancellationToken>
+#include <OpenThreads/Clock>
+#include <OpenThreads/ScopedLock>
+
+#include <algorithm>
+#include <assert.h>
+
+using namespace OpenThreads;
+
+CancellationToken::CancellationToken()
+    : _cancelled(false), _parent(0)
+{
+}
+
+CancellationToken::CancellationToken(CancellationToken& parent)
+    : _cancelled(false), _parent(&parent)
+{
+    // Under the parent's lock, so that a concurrent cancel() of the parent
+    // either sees this child or has already set the flag read here.
+    ScopedLock<Mutex> lock(parent._mutex);
+    if (parent._cancelled.load(std::memory_order_relaxed))
+        _cancelled.store(true, std::memory_order_relaxed);
+    else
+        parent._children.push_back(this);
+}
+
+CancellationToken::~CancellationToken()
+{
+    assert(_children.empty());
+    if (_parent)
+    {
+        ScopedLock<Mutex> lock(_parent->_mutex);
+        std::vector<CancellationToken*>& siblings = _parent->_children;
+        std::vector<CancellationToken*>::iterator it = std::find(siblings.begin(), siblings.end(), this);
+        if (it != siblings.end())
+            siblings.erase(it);
+    }
+}
+
+void CancellationToken::cancel()
+{
+    ScopedLock<Mutex> lock(_mutex);
+    if (_cancelled.load(std::memory_order_relaxed))
+        return;
+    _cancelled.store(true, std::memory_order_release);
+
+    for (size_t i = 0; i < _callbacks.size(); ++i)
+        _callbacks[i]->onCancel();
+    _callbacks.clear();
+
+    // Children unregister themselves under this lock, so they are all alive.
+    for (size_t i = 0; i < _children.size(); ++i)
+        _children[i]->cancel();
+
+    _condition.broadcast();
+}
+
+bool CancellationToken::wait(unsigned long timeoutMs)
+{
+    ScopedLock<Mutex> lock(_mutex);
+    unsigned long long deadline = timeoutMs == FOREVER ? 0 : Clock::milliseconds() + timeoutMs;
+    while (!_cancelled.load(std::memory_order_relaxed))
+    {
+        if (timeoutMs == FOREVER)
+        {
+            _condition.wait(&_mutex);
+            continue;
+        }
+        unsigned long long now = Clock::milliseconds();
+        if (now >= deadline)
+            return false;
+        _condition.wait(&_mutex, (unsigned long)(deadline - now));
+    }
+    return true;
+}
+
+bool CancellationToken::addCallback(CancellationCallback* callback)
+{
+    ScopedLock<Mutex> lock(_mutex);
+    if (_cancelled.load(std::memory_order_relaxed))
+        return false;
+    _callbacks.push_back(callback);
+    return true;
+}
+
+void CancellationToken::removeCallback(CancellationCallback* callback)
+{
+    ScopedLock<Mutex> lock(_mutex);
+    std::vector<CancellationCallback*>::iterator it = std::find(_callbacks.begin(), _callbacks.end(), callback);
+    if (it != _callbacks.end())
+        _callbacks.erase(it);
+}
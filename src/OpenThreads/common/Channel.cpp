@@ -0,0 +1,267 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/Channel>
+#include <OpenThreads/Backoff>
+#include <OpenThreads/Clock>
+#include <OpenThreads/Condition>
+#include <OpenThreads/ScopedLock>
+
+using namespace OpenThreads;
+
+namespace {
+
+const unsigned long long NO_DEADLINE = ~0ULL;
+
+// Number of polls before a waiter parks.
+const unsigned int SPIN_COUNT = 50;
+
+// Parks a thread on a Condition until notified or the deadline passes.
+class ThreadWaiter : public ChannelWaiter
+{
+public:
+    ThreadWaiter() : _notified(false) {}
+
+    virtual bool notify()
+    {
+        ScopedLock<Mutex> lock(_mutex);
+        if (_notified)
+            return false;
+        _notified = true;
+        _condition.signal();
+        return true;
+    }
+
+    void reset()
+    {
+        ScopedLock<Mutex> lock(_mutex);
+        _notified = false;
+    }
+
+    bool isNotified()
+    {
+        ScopedLock<Mutex> lock(_mutex);
+        return _notified;
+    }
+
+    // Return false if the deadline passed without a notification.
+    bool wait(unsigned long long deadline)
+    {
+        ScopedLock<Mutex> lock(_mutex);
+        while (!_notified)
+        {
+            if (deadline == NO_DEADLINE)
+            {
+                _condition.wait(&_mutex);
+                continue;
+            }
+            unsigned long long now = Clock::milliseconds();
+            if (now >= deadline)
+                return false;
+            _condition.wait(&_mutex, (unsigned long)(deadline - now));
+        }
+        return true;
+    }
+
+private:
+    Mutex _mutex;
+    Condition _condition;
+    bool _notified;
+};
+
+// Wakes a waiter up when a token is cancelled.
+class WakeOnCancel : public CancellationCallback
+{
+public:
+    WakeOnCancel(ChannelWaiter& waiter) : _waiter(waiter) {}
+
+    virtual void onCancel() { _waiter.notify(); }
+
+private:
+    ChannelWaiter& _waiter;
+};
+
+thread_local unsigned int t_selectStart = 0;
+
+// The waiters to call notifyUnlocked() for once the notifying thread has
+// released the waiter lock
+thread_local std::vector<ChannelWaiter*>* t_deferred = 0;
+
+int findReady(ChannelBase* const* channels, unsigned int count, unsigned int start)
+{
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        unsigned int index = (start + i) % count;
+        if (channels[index]->isReady(ChannelBase::RECV))
+            return (int)index;
+    }
+    return -1;
+}
+
+}
+
+void ChannelWaiter::deferUntilUnlocked()
+{
+    if (t_deferred)
+        t_deferred->push_back(this);
+    else
+        notifyUnlocked();
+}
+
+ChannelBase::ChannelBase()
+    : _closedFlag(0)
+{
+    _waiterCount[SEND].store(0, std::memory_order_relaxed);
+    _waiterCount[RECV].store(0, std::memory_order_relaxed);
+}
+
+ChannelBase::~ChannelBase()
+{
+}
+
+void ChannelBase::close()
+{
+    // Stop the senders before telling anyone the channel is closed, so that
+    // a receiver that sees it closed and empty knows it stays empty.
+    markClosed();
+    _closedFlag.store(1, std::memory_order_release);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    notifyWaiters(SEND, true);
+    notifyWaiters(RECV, true);
+}
+
+unsigned long long ChannelBase::getDeadline(unsigned long timeoutMs)
+{
+    return timeoutMs == FOREVER ? NO_DEADLINE : Clock::milliseconds() + timeoutMs;
+}
+
+void ChannelBase::addWaiter(Side side, ChannelWaiter* waiter, bool broadcast)
+{
+    {
+        ScopedLock<Mutex> lock(_waiterMutex);
+        Entry e = { waiter, broadcast };
+        _waiters[side].push_back(e);
+        _waiterCount[side].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Pairs with the fence in notify(): either the other side sees this
+    // waiter, or the caller's isReady() check sees its update.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void ChannelBase::removeWaiter(Side side, ChannelWaiter* waiter)
+{
+    ScopedLock<Mutex> lock(_waiterMutex);
+    std::vector<Entry>& waiters = _waiters[side];
+    for (size_t i = 0; i < waiters.size(); ++i)
+    {
+        if (waiters[i].waiter == waiter)
+        {
+            waiters.erase(waiters.begin() + i);
+            _waiterCount[side].fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+void ChannelBase::notifyWaiters(Side side, bool all)
+{
+    std::vector<ChannelWaiter*> deferred;
+    std::vector<ChannelWaiter*>* previous = t_deferred;
+    t_deferred = &deferred;
+    {
+        ScopedLock<Mutex> lock(_waiterMutex);
+        std::vector<Entry>& waiters = _waiters[side];
+
+        // Wake every broadcast waiter, and the first other waiter that has
+        // not been woken up already.
+        bool woken = false;
+        for (size_t i = 0; i < waiters.size(); ++i)
+        {
+            if (waiters[i].broadcast || all)
+                waiters[i].waiter->notify();
+            else if (!woken)
+                woken = waiters[i].waiter->notify();
+        }
+    }
+    t_deferred = previous;
+
+    for (size_t i = 0; i < deferred.size(); ++i)
+        deferred[i]->notifyUnlocked();
+}
+
+bool ChannelBase::wait(Side side, unsigned long long deadline, CancellationToken* token)
+{
+    Backoff backoff;
+    for (unsigned int i = 0; i < SPIN_COUNT; ++i)
+    {
+        if (isReady(side))
+            return true;
+        if (token && token->isCancelled())
+            return false;
+        backoff.pause();
+    }
+
+    ThreadWaiter waiter;
+    WakeOnCancel wake(waiter);
+    if (token && !token->addCallback(&wake))
+        return false;
+
+    addWaiter(side, &waiter);
+    bool result = isReady(side) || waiter.wait(deadline);
+    removeWaiter(side, &waiter);
+
+    if (token)
+    {
+        token->removeCallback(&wake);
+        if (token->isCancelled())
+            result = false;
+    }
+
+    // Notified while giving up: the notification was meant for a waiter
+    // that goes on, so hand it to the next one
+    if (!result && waiter.isNotified())
+        notifyWaiters(side, false);
+    return result;
+}
+
+int ChannelBase::select(ChannelBase* const* channels, unsigned int count, unsigned long timeoutMs)
+{
+    if (count == 0)
+        return -1;
+
+    // Start scanning at a different channel each time, so that a channel
+    // that is always ready (a closed one, say) does not hide the others.
+    unsigned int start = t_selectStart++ % count;
+    int ready = findReady(channels, count, start);
+    if (ready >= 0)
+        return ready;
+
+    unsigned long long deadline = getDeadline(timeoutMs);
+    ThreadWaiter waiter;
+    for (unsigned int i = 0; i < count; ++i)
+        channels[i]->addWaiter(RECV, &waiter, true);
+
+    for (;;)
+    {
+        ready = findReady(channels, count, start);
+        if (ready >= 0 || !waiter.wait(deadline))
+            break;
+        waiter.reset();
+    }
+
+    for (unsigned int i = 0; i < count; ++i)
+        channels[i]->removeWaiter(RECV, &waiter);
+    return ready;
+}
@@ -0,0 +1,119 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/Clock>
+#include <OpenThreads/Thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+using namespace OpenThreads;
+
+namespace {
+
+#if defined(_WIN32)
+
+unsigned long long getFrequency()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (unsigned long long)frequency.QuadPart;
+}
+
+#elif defined(__APPLE__)
+
+mach_timebase_info_data_t getTimebase()
+{
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    return timebase;
+}
+
+#endif
+
+double calibrate()
+{
+#if defined(OPENTHREADS_HAVE_CYCLE_COUNTER)
+    // Take the shortest of a few measurements of both clocks' start, so that
+    // a preemption between the two reads does not skew the rate.
+    unsigned long long startNs = 0, startCycles = 0, endNs = 0, endCycles = 0;
+    unsigned long long best = ~0ULL;
+    for (int i = 0; i < 5; ++i)
+    {
+        unsigned long long c0 = Clock::cycles();
+        unsigned long long ns = Clock::nanoseconds();
+        unsigned long long c1 = Clock::cycles();
+        if (c1 - c0 < best)
+        {
+            best = c1 - c0;
+            startNs = ns;
+            startCycles = c0 + (c1 - c0) / 2;
+        }
+    }
+
+    Thread::microSleep(10000);
+
+    best = ~0ULL;
+    for (int i = 0; i < 5; ++i)
+    {
+        unsigned long long c0 = Clock::cycles();
+        unsigned long long ns = Clock::nanoseconds();
+        unsigned long long c1 = Clock::cycles();
+        if (c1 - c0 < best)
+        {
+            best = c1 - c0;
+            endNs = ns;
+            endCycles = c0 + (c1 - c0) / 2;
+        }
+    }
+
+    if (endNs > startNs && endCycles > startCycles)
+        return (double)(endCycles - startCycles) / (double)(endNs - startNs);
+#endif
+    return 1.0;
+}
+
+}
+
+unsigned long long Clock::nanoseconds()
+{
+#if defined(_WIN32)
+    static const unsigned long long s_frequency = getFrequency();
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    unsigned long long ticks = (unsigned long long)counter.QuadPart;
+    // In two parts, so that ticks * 1e9 cannot overflow
+    return (ticks / s_frequency) * 1000000000ULL + (ticks % s_frequency) * 1000000000ULL / s_frequency;
+#elif defined(__APPLE__)
+    static const mach_timebase_info_data_t s_timebase = getTimebase();
+    return mach_absolute_time() * s_timebase.numer / s_timebase.denom;
+#else
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC_RAW)
+    if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts) != 0)
+#endif
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+#endif
+}
+
+double Clock::getCyclesPerNanosecond()
+{
+    static const double s_cyclesPerNs = calibrate();
+    return s_cyclesPerNs;
+}
@@ -0,0 +1,251 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/EpochDomain>
+#include <OpenThreads/Backoff>
+#include "ThreadRecords.h"
+
+#include <assert.h>
+#include <vector>
+
+using namespace OpenThreads;
+
+namespace {
+
+struct Retired
+{
+    Retired(void* p, EpochDomain::Deleter d, unsigned int e) : ptr(p), deleter(d), epoch(e) {}
+
+    void* ptr;
+    EpochDomain::Deleter deleter;
+    unsigned int epoch;
+};
+
+// A record's state is (epoch << 1) | ACTIVE while its thread is inside a
+// critical section, and 0 otherwise.
+const unsigned int ACTIVE = 1;
+const unsigned int EPOCH_MASK = ~0u >> 1;
+
+void freeAll(std::vector<Retired>& retired)
+{
+    for (size_t i = 0; i < retired.size(); ++i)
+        retired[i].deleter(retired[i].ptr);
+}
+
+}
+
+//-----------------------------------------------------------------------------
+// Records are never unlinked before the domain goes away, so scanning the
+// list needs no synchronization beyond the acquire loads. A record belongs
+// to the thread that has set inUse; only that thread touches nesting,
+// retired and collectAt.
+//
+struct EpochDomain::Record
+{
+    Record() : state(0), inUse(true), next(0), nesting(0), collectAt(0) {}
+
+    std::atomic<unsigned int> state;
+    char pad[OPENTHREADS_CACHE_LINE_SIZE];
+
+    std::atomic<bool> inUse;
+    Record* next;
+
+    unsigned int nesting;
+    std::vector<Retired> retired;
+    size_t collectAt;
+};
+
+EpochDomain::EpochDomain(unsigned int retireThreshold)
+    : _epoch(0), _records(0), _retireThreshold(retireThreshold > 0 ? retireThreshold : 1)
+{
+    _serial = ThreadRecords::registerOwner(this);
+}
+
+EpochDomain::~EpochDomain()
+{
+    ThreadRecords::unregisterOwner(this);
+
+    Record* record = _records.load(std::memory_order_acquire);
+    while (record)
+    {
+        assert(record->nesting == 0 || !record->inUse.load());
+        Record* next = record->next;
+        freeAll(record->retired);
+        delete record;
+        record = next;
+    }
+}
+
+EpochDomain& EpochDomain::instance()
+{
+    static EpochDomain s_domain;
+    return s_domain;
+}
+
+EpochDomain::Record* EpochDomain::getRecord()
+{
+    Record* record = static_cast<Record*>(ThreadRecords::find(this, _serial));
+    return record ? record : acquireRecord();
+}
+
+EpochDomain::Record* EpochDomain::acquireRecord()
+{
+    // Reuse the record of an exited thread if there is one.
+    Record* record = _records.load(std::memory_order_acquire);
+    for (; record; record = record->next)
+    {
+        bool expected = false;
+        if (!record->inUse.load(std::memory_order_relaxed) &&
+            record->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            break;
+    }
+
+    if (!record)
+    {
+        record = new Record;
+        record->collectAt = _retireThreshold;
+        Record* head = _records.load(std::memory_order_relaxed);
+        do
+        {
+            record->next = head;
+        }
+        while (!_records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    ThreadRecords::add(this, _serial, record, &EpochDomain::threadExited);
+    return record;
+}
+
+void EpochDomain::threadExited(void* domain, void* record)
+{
+    (void)domain;
+    Record* r = static_cast<Record*>(record);
+
+    // Whatever it retired stays in the record, for the next owner or for
+    // collect() to free.
+    r->nesting = 0;
+    r->state.store(0, std::memory_order_release);
+    r->inUse.store(false, std::memory_order_release);
+}
+
+void EpochDomain::enter()
+{
+    Record* record = getRecord();
+    if (record->nesting++ == 0)
+    {
+        unsigned int epoch = _epoch.load(std::memory_order_relaxed);
+        record->state.store(((epoch & EPOCH_MASK) << 1) | ACTIVE, std::memory_order_relaxed);
+
+        // Publish the state before any shared pointer is read; pairs with
+        // the fence in tryAdvance().
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+void EpochDomain::leave()
+{
+    Record* record = getRecord();
+    assert(record->nesting > 0);
+    if (--record->nesting == 0)
+        record->state.store(0, std::memory_order_release);
+}
+
+bool EpochDomain::isInCriticalSection()
+{
+    return getRecord()->nesting > 0;
+}
+
+bool EpochDomain::tryAdvance()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    unsigned int epoch = _epoch.load(std::memory_order_relaxed);
+
+    for (Record* record = _records.load(std::memory_order_acquire); record; record = record->next)
+    {
+        unsigned int state = record->state.load(std::memory_order_relaxed);
+        if ((state & ACTIVE) && (state >> 1) != (epoch & EPOCH_MASK))
+            return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    _epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel, std::memory_order_relaxed);
+    return true;
+}
+
+void EpochDomain::retire(void* ptr, Deleter deleter)
+{
+    Record* record = getRecord();
+    record->retired.push_back(Retired(ptr, deleter, _epoch.load(std::memory_order_seq_cst)));
+
+    if (record->retired.size() >= record->collectAt)
+        collect(record);
+}
+
+unsigned int EpochDomain::collect(Record* record)
+{
+    tryAdvance();
+    unsigned int epoch = _epoch.load(std::memory_order_acquire);
+
+    // Deleters may retire more objects, so run them on a separate list.
+    std::vector<Retired> ready;
+    std::vector<Retired>& retired = record->retired;
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); ++i)
+    {
+        if (epoch - retired[i].epoch >= 2)
+            ready.push_back(retired[i]);
+        else
+            retired[kept++] = retired[i];
+    }
+    retired.resize(kept, Retired(0, 0, 0));
+
+    // While readers hold the epoch back, do not rescan on every retire().
+    record->collectAt = kept + _retireThreshold;
+
+    freeAll(ready);
+    return (unsigned int)ready.size();
+}
+
+unsigned int EpochDomain::collect()
+{
+    unsigned int freed = collect(getRecord());
+
+    // Objects left behind by exited threads.
+    for (Record* record = _records.load(std::memory_order_acquire); record; record = record->next)
+    {
+        bool expected = false;
+        if (!record->inUse.load(std::memory_order_relaxed) &&
+            record->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            if (!record->retired.empty())
+                freed += collect(record);
+            record->inUse.store(false, std::memory_order_release);
+        }
+    }
+    return freed;
+}
+
+void EpochDomain::synchronize()
+{
+    assert(!isInCriticalSection());
+
+    // Two advances guarantee that every section active on entry has ended.
+    unsigned int start = _epoch.load(std::memory_order_acquire);
+    Backoff backoff;
+    while (_epoch.load(std::memory_order_acquire) - start < 2)
+    {
+        if (!tryAdvance())
+            backoff.pause();
+    }
+    collect();
+}
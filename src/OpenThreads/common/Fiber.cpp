@@ -0,0 +1,462 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#if defined(__APPLE__) && !defined(_XOPEN_SOURCE)
+// ucontext is only declared for XSI applications
+#define _XOPEN_SOURCE 600
+#endif
+
+#include <OpenThreads/Fiber>
+#include <OpenThreads/ScopedLock>
+#include "FiberWaitList.h"
+#include <assert.h>
+#include <limits.h>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+using namespace OpenThreads;
+
+
+namespace {
+
+std::atomic<size_t> s_stackSize(Fiber::DEFAULT_STACK_SIZE);
+std::atomic<unsigned int> s_activeCount(0);
+
+size_t getPageSize()
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwPageSize;
+#else
+	long size = sysconf(_SC_PAGESIZE);
+	return size > 0 ? (size_t)size : 4096;
+#endif
+}
+
+// Thread::microSleep() takes an unsigned int, which a long delay overflows
+void sleepThread(unsigned long long microseconds)
+{
+	while (microseconds > 0)
+	{
+		unsigned int step = microseconds > UINT_MAX ? UINT_MAX : (unsigned int)microseconds;
+		Thread::microSleep(step);
+		microseconds -= step;
+	}
+}
+
+#if defined(_WIN32)
+// The fiber the worker thread runs as when it runs no task fiber
+thread_local LPVOID t_threadFiber = nullptr;
+
+LPVOID getThreadFiber()
+{
+	if (t_threadFiber == nullptr)
+	{
+		t_threadFiber = ConvertThreadToFiberEx(nullptr, FIBER_FLAG_FLOAT_SWITCH);
+		if (t_threadFiber == nullptr)
+			t_threadFiber = GetCurrentFiber();
+	}
+	return t_threadFiber;
+}
+#endif
+
+}
+
+// A stack and the state of the fiber running on it. Fibers are recycled:
+// once its task returns, a fiber switches back to its worker and waits there
+// for its next task, so a cached fiber is restarted without a new context.
+class Fiber::Impl : public SuspendableFiber
+{
+public:
+	// Returns a fiber from the cache, or a new one, or nullptr
+	static Impl* acquire();
+	static void release(Impl* fiber);
+
+	void prepare(ThreadPool* pool, Task* task)
+	{
+		_pool = pool;
+		_task = task;
+		_worker = nullptr;
+		_finished = false;
+	}
+
+	Task* getRunner() { return &_runner; }
+
+	// SuspendableFiber
+	virtual void suspend() { switchOut(); }
+	virtual void resume() { _worker->queue(&_runner); }
+	virtual unsigned long long startTimer(unsigned long ms, FiberTimer* timer) { return schedule(ms * 1000ULL, timer); }
+	virtual bool cancelTimer(unsigned long long id) { return _pool->cancel(id); }
+
+	void sleep(unsigned long long microseconds)
+	{
+		if (schedule(microseconds, &_wake) == 0)
+			sleepThread(microseconds);
+		else
+			suspend();
+	}
+
+private:
+	// Switches to the fiber when run by the worker: queued once when the
+	// fiber is submitted, then each time it is resumed
+	class Runner : public Task
+	{
+	public:
+		Runner(Impl* fiber) : _fiber(fiber) {}
+		virtual void execute(TaskContext& ctxt) { _fiber->switchIn(ctxt); }
+	private:
+		Impl* _fiber;
+	};
+
+	// Scheduled on the pool's timers with FireAtOnce, which calls its timer
+	// from the timer thread instead of giving it to a worker
+	class TimerTask : public Task
+	{
+	public:
+		TimerTask() : _timer(nullptr) {}
+		virtual void execute(TaskContext&) {}
+		void fire() { _timer->onTimer(); }
+		FiberTimer* _timer;
+	};
+
+	class FireAtOnce : public ThreadPool::DispatchOp
+	{
+	public:
+		virtual bool dispatch(const ThreadPool::Workers&, Task* task)
+		{
+			static_cast<TimerTask*>(task)->fire();
+			return true;
+		}
+	};
+
+	class Wake : public FiberTimer
+	{
+	public:
+		Wake(Impl* fiber) : _fiber(fiber) {}
+		virtual void onTimer() { _fiber->resume(); }
+	private:
+		Impl* _fiber;
+	};
+
+	Impl(size_t stackSize);
+	virtual ~Impl();
+	bool allocate();
+
+	unsigned long long schedule(unsigned long long microseconds, FiberTimer* timer)
+	{
+		static FireAtOnce s_fireAtOnce;
+		_timerTask._timer = timer;
+		return _pool->schedule(&_timerTask, microseconds, &s_fireAtOnce);
+	}
+
+	void switchIn(TaskContext& ctxt);
+	void switchOut();
+	void loop();
+
+#if defined(_WIN32)
+	static VOID CALLBACK entry(LPVOID parameter);
+#else
+	static void entry(unsigned int high, unsigned int low);
+#endif
+
+	size_t _stackSize;
+	ThreadPool* _pool;
+	Task* _task;
+	// Set when first run; the fiber always resumes on it
+	WorkerThread* _worker;
+	TaskContext _context;
+	bool _finished;
+	Runner _runner;
+	TimerTask _timerTask;
+	Wake _wake;
+
+#if defined(_WIN32)
+	LPVOID _handle;
+	LPVOID _scheduler;
+#else
+	void* _memory;
+	size_t _mappedSize;
+	ucontext_t _ucontext;
+	ucontext_t* _scheduler;
+#endif
+
+	static const size_t MAX_CACHED = 1024;
+	static Mutex s_cacheMutex;
+	static std::vector<Impl*> s_cache;
+};
+
+Mutex Fiber::Impl::s_cacheMutex;
+std::vector<Fiber::Impl*> Fiber::Impl::s_cache;
+
+Fiber::Impl::Impl(size_t stackSize)
+	: _stackSize(stackSize), _pool(nullptr), _task(nullptr), _worker(nullptr), _finished(false),
+	_runner(this), _wake(this)
+#if defined(_WIN32)
+	, _handle(nullptr), _scheduler(nullptr)
+#else
+	, _memory(nullptr), _mappedSize(0), _scheduler(nullptr)
+#endif
+{
+}
+
+Fiber::Impl::~Impl()
+{
+#if defined(_WIN32)
+	if (_handle)
+		DeleteFiber(_handle);
+#else
+	if (_memory)
+		munmap(_memory, _mappedSize);
+#endif
+}
+
+bool Fiber::Impl::allocate()
+{
+#if defined(_WIN32)
+	// The system reserves the stack with a guard page and commits it as it grows
+	_handle = CreateFiberEx(0, _stackSize, FIBER_FLAG_FLOAT_SWITCH, entry, this);
+	return _handle != nullptr;
+#else
+	size_t pageSize = getPageSize();
+	_mappedSize = _stackSize + pageSize;
+
+	int flags = MAP_PRIVATE;
+#if defined(MAP_ANONYMOUS)
+	flags |= MAP_ANONYMOUS;
+#else
+	flags |= MAP_ANON;
+#endif
+#if defined(MAP_NORESERVE)
+	// Only the pages touched are committed
+	flags |= MAP_NORESERVE;
+#endif
+#if defined(MAP_STACK)
+	flags |= MAP_STACK;
+#endif
+	void* memory = mmap(nullptr, _mappedSize, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (memory == MAP_FAILED)
+		return false;
+	_memory = memory;
+
+	// Stacks grow down: the guard page is the lowest one
+	if (mprotect(_memory, pageSize, PROT_NONE) != 0)
+		return false;
+
+	if (getcontext(&_ucontext) != 0)
+		return false;
+	_ucontext.uc_stack.ss_sp = static_cast<char*>(_memory) + pageSize;
+	_ucontext.uc_stack.ss_size = _stackSize;
+	_ucontext.uc_link = nullptr;
+
+	// makecontext() only passes ints
+	unsigned long long address = (unsigned long long)(size_t)this;
+	makecontext(&_ucontext, (void (*)())entry, 2, (unsigned int)(address >> 32), (unsigned int)address);
+	return true;
+#endif
+}
+
+Fiber::Impl* Fiber::Impl::acquire()
+{
+	size_t stackSize = s_stackSize.load(std::memory_order_relaxed);
+	{
+		ScopedLock<Mutex> slock(s_cacheMutex);
+		while (!s_cache.empty())
+		{
+			Impl* fiber = s_cache.back();
+			s_cache.pop_back();
+			if (fiber->_stackSize == stackSize)
+				return fiber;
+			// Allocated before the size changed
+			delete fiber;
+		}
+	}
+
+	Impl* fiber = new Impl(stackSize);
+	if (!fiber->allocate())
+	{
+		delete fiber;
+		return nullptr;
+	}
+	return fiber;
+}
+
+void Fiber::Impl::release(Impl* fiber)
+{
+	{
+		ScopedLock<Mutex> slock(s_cacheMutex);
+		if (s_cache.size() < MAX_CACHED && fiber->_stackSize == s_stackSize.load(std::memory_order_relaxed))
+		{
+			s_cache.push_back(fiber);
+			return;
+		}
+	}
+	delete fiber;
+}
+
+void Fiber::Impl::switchIn(TaskContext& ctxt)
+{
+	if (_worker == nullptr)
+	{
+		_worker = ctxt.getWorker();
+		assert(_worker);
+		_context = TaskContext(_pool, _worker);
+		setTask(_context, _task);
+		adjustFiberCount(_worker, 1);
+	}
+	assert(ctxt.getWorker() == _worker);
+
+	SuspendableFiber* previousFiber = SuspendableFiber::current();
+	TaskContext* previousContext = TaskContext::current();
+	SuspendableFiber::setCurrent(this);
+	setCurrentContext(&_context);
+
+#if defined(_WIN32)
+	_scheduler = getThreadFiber();
+	SwitchToFiber(_handle);
+#else
+	ucontext_t scheduler;
+	_scheduler = &scheduler;
+	swapcontext(&scheduler, &_ucontext);
+#endif
+
+	// Back from the fiber: it is suspended or done
+	setCurrentContext(previousContext);
+	SuspendableFiber::setCurrent(previousFiber);
+
+	if (_finished)
+	{
+		adjustFiberCount(_worker, -1);
+		s_activeCount.fetch_sub(1, std::memory_order_relaxed);
+		release(this);
+	}
+}
+
+void Fiber::Impl::switchOut()
+{
+#if defined(_WIN32)
+	SwitchToFiber(_scheduler);
+#else
+	swapcontext(&_ucontext, _scheduler);
+#endif
+}
+
+void Fiber::Impl::loop()
+{
+	for (;;)
+	{
+		_task->execute(_context);
+		_finished = true;
+		// Resumed with the next task once recycled
+		switchOut();
+	}
+}
+
+#if defined(_WIN32)
+VOID CALLBACK Fiber::Impl::entry(LPVOID parameter)
+{
+	static_cast<Impl*>(parameter)->loop();
+}
+#else
+void Fiber::Impl::entry(unsigned int high, unsigned int low)
+{
+	unsigned long long address = ((unsigned long long)high << 32) | low;
+	reinterpret_cast<Impl*>((size_t)address)->loop();
+}
+#endif
+
+
+bool Fiber::submit(ThreadPool& pool, Task* task, ThreadPool::DispatchOp* op)
+{
+	assert(task);
+	Impl* fiber = Impl::acquire();
+	if (fiber == nullptr)
+		return false;
+
+	fiber->prepare(&pool, task);
+	s_activeCount.fetch_add(1, std::memory_order_relaxed);
+	if (!pool.submit(fiber->getRunner(), op))
+	{
+		s_activeCount.fetch_sub(1, std::memory_order_relaxed);
+		Impl::release(fiber);
+		return false;
+	}
+	return true;
+}
+
+bool Fiber::isFiber()
+{
+	return SuspendableFiber::current() != nullptr;
+}
+
+void Fiber::yield()
+{
+	SuspendableFiber* fiber = SuspendableFiber::current();
+	if (fiber == nullptr)
+	{
+		Thread::YieldCurrentThread();
+		return;
+	}
+	// Queued behind the worker's tasks, and run once switched out
+	fiber->resume();
+	fiber->suspend();
+}
+
+void Fiber::sleep(unsigned long long microseconds)
+{
+	SuspendableFiber* fiber = SuspendableFiber::current();
+	if (fiber == nullptr)
+		sleepThread(microseconds);
+	else
+		static_cast<Impl*>(fiber)->sleep(microseconds);
+}
+
+void Fiber::setStackSize(size_t bytes)
+{
+	size_t pageSize = getPageSize();
+	if (bytes < pageSize)
+		bytes = pageSize;
+	s_stackSize.store((bytes + pageSize - 1) / pageSize * pageSize, std::memory_order_relaxed);
+}
+
+size_t Fiber::getStackSize()
+{
+	return s_stackSize.load(std::memory_order_relaxed);
+}
+
+unsigned int Fiber::getActiveCount()
+{
+	return s_activeCount.load(std::memory_order_relaxed);
+}
+
+void Fiber::adjustFiberCount(WorkerThread* worker, int delta)
+{
+	worker->_fibers += delta;
+}
+
+void Fiber::setTask(TaskContext& context, Task* task)
+{
+	context._task = task;
+}
+
+void Fiber::setCurrentContext(TaskContext* context)
+{
+	TaskContext::setCurrent(context);
+}
@@ -0,0 +1,168 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include "FiberWaitList.h"
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+using namespace OpenThreads;
+
+namespace {
+
+thread_local SuspendableFiber* t_currentFiber = 0;
+
+}
+
+SuspendableFiber* SuspendableFiber::current()
+{
+    return t_currentFiber;
+}
+
+void SuspendableFiber::setCurrent(SuspendableFiber* fiber)
+{
+    t_currentFiber = fiber;
+}
+
+struct FiberWaitList::Waiter : public FiberTimer
+{
+    Waiter(FiberWaitList* list, SuspendableFiber* fiber)
+        : list(list), fiber(fiber), next(0), prev(0), linked(false), timedOut(false), timerDone(false) {}
+
+    // Runs on the timer's thread
+    virtual void onTimer()
+    {
+        SuspendableFiber* toResume = list->remove(this) ? fiber : 0;
+        if (toResume)
+            timedOut = true;
+        // The waiter may be gone once this is seen, or once resumed
+        timerDone.store(true, std::memory_order_release);
+        if (toResume)
+            toResume->resume();
+    }
+
+    FiberWaitList* list;
+    SuspendableFiber* fiber;
+    Waiter* next;
+    Waiter* prev;
+    // In the list; changed under the list's lock
+    bool linked;
+    bool timedOut;
+    std::atomic<bool> timerDone;
+};
+
+FiberWaitList::Result FiberWaitList::wait(SuspendableFiber* fiber, Mutex* mutex, unsigned long ms)
+{
+    Waiter waiter(this, fiber);
+    {
+        ScopedLock<SpinMutex> lock(_lock);
+        waiter.prev = _tail;
+        if (_tail)
+            _tail->next = &waiter;
+        else
+            _head = &waiter;
+        _tail = &waiter;
+        waiter.linked = true;
+        _count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    unsigned long long timer = 0;
+    if (ms != FOREVER)
+    {
+        timer = fiber->startTimer(ms, &waiter);
+        // Unless a signal came meanwhile, back out and let the caller wait
+        // on the native condition
+        if (timer == 0 && remove(&waiter))
+            return NO_TIMER;
+    }
+
+    // A signal from here on resumes the fiber once it is suspended
+    mutex->unlock();
+    fiber->suspend();
+
+    if (timer != 0 && !waiter.timedOut && !fiber->cancelTimer(timer))
+    {
+        // Signalled while the timer fired: it still uses the waiter
+        while (!waiter.timerDone.load(std::memory_order_acquire))
+            Thread::YieldCurrentThread();
+    }
+
+    mutex->lock();
+    return waiter.timedOut ? TIMED_OUT : SIGNALLED;
+}
+
+bool FiberWaitList::remove(Waiter* waiter)
+{
+    ScopedLock<SpinMutex> lock(_lock);
+    if (!waiter->linked)
+        return false;
+
+    if (waiter->prev)
+        waiter->prev->next = waiter->next;
+    else
+        _head = waiter->next;
+    if (waiter->next)
+        waiter->next->prev = waiter->prev;
+    else
+        _tail = waiter->prev;
+    waiter->linked = false;
+    _count.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool FiberWaitList::signal()
+{
+    if (_count.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    SuspendableFiber* fiber;
+    {
+        ScopedLock<SpinMutex> lock(_lock);
+        Waiter* waiter = _head;
+        if (!waiter)
+            return false;
+        _head = waiter->next;
+        if (_head)
+            _head->prev = 0;
+        else
+            _tail = 0;
+        waiter->linked = false;
+        _count.fetch_sub(1, std::memory_order_relaxed);
+        fiber = waiter->fiber;
+    }
+    fiber->resume();
+    return true;
+}
+
+void FiberWaitList::broadcast()
+{
+    if (_count.load(std::memory_order_relaxed) == 0)
+        return;
+
+    Waiter* waiters;
+    {
+        ScopedLock<SpinMutex> lock(_lock);
+        waiters = _head;
+        for (Waiter* waiter = _head; waiter; waiter = waiter->next)
+            waiter->linked = false;
+        _head = _tail = 0;
+        _count.store(0, std::memory_order_relaxed);
+    }
+
+    // A waiter is gone as soon as its fiber runs again
+    while (waiters)
+    {
+        Waiter* next = waiters->next;
+        waiters->fiber->resume();
+        waiters = next;
+    }
+}
@@ -0,0 +1,114 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+//
+// FiberWaitList.h - private header for fibers waiting on a Condition
+// ~~~~~~~~~~~~~~~
+//
+
+#ifndef _FIBERWAITLIST_H_
+#define _FIBERWAITLIST_H_
+
+#include <OpenThreads/Mutex>
+#include <OpenThreads/SpinMutex>
+#include <atomic>
+
+namespace OpenThreads {
+
+//-----------------------------------------------------------------------------
+// Called back, on another thread, when the timer of a suspended fiber fires.
+//
+class FiberTimer
+{
+public:
+    virtual ~FiberTimer() {}
+    virtual void onTimer() = 0;
+};
+
+//-----------------------------------------------------------------------------
+// What a fiber scheduler offers to the waits of the library's primitives,
+// which are built without it: Condition only sees this interface, so that
+// it does not depend on the ThreadPool. A fiber always resumes on the
+// thread it was suspended on.
+//
+class SuspendableFiber
+{
+public:
+    // The fiber running on the calling thread, or 0.
+    static SuspendableFiber* current();
+    static void setCurrent(SuspendableFiber* fiber);
+
+    // Give the thread back until resume() is called. Each suspend() is
+    // matched by exactly one resume(), which may come first.
+    virtual void suspend() = 0;
+
+    // Make the suspended fiber run again. Any thread.
+    virtual void resume() = 0;
+
+    // Call timer->onTimer() in ms milliseconds from another thread.
+    // Returns 0 if no timer can be started. A fiber has at most one timer.
+    virtual unsigned long long startTimer(unsigned long ms, FiberTimer* timer) = 0;
+
+    // Returns false if the timer has fired, or is firing.
+    virtual bool cancelTimer(unsigned long long id) = 0;
+
+protected:
+    virtual ~SuspendableFiber() {}
+};
+
+//-----------------------------------------------------------------------------
+// The fibers waiting on a Condition, next to the threads waiting on its
+// native condition variable. Each fiber waiting is a record on its own
+// stack, linked in FIFO order. Signalling checks a counter before taking the
+// list's lock, so conditions that no fiber waits on pay one relaxed load.
+//
+class FiberWaitList
+{
+public:
+    enum Result
+    {
+        SIGNALLED,
+        TIMED_OUT,
+        // No timer could be started: wait on the native condition instead
+        NO_TIMER
+    };
+
+    static const unsigned long FOREVER = ~0UL;
+
+    FiberWaitList() : _head(0), _tail(0), _count(0) {}
+
+    // Suspend fiber, whose caller holds mutex, until signalled or until ms
+    // have passed. mutex is released meanwhile and held again on return,
+    // except for NO_TIMER where it is left held and the wait not started.
+    Result wait(SuspendableFiber* fiber, Mutex* mutex, unsigned long ms);
+
+    // Resume the first fiber waiting. Returns false if there was none.
+    bool signal();
+
+    // Resume every fiber waiting.
+    void broadcast();
+
+private:
+    struct Waiter;
+
+    bool remove(Waiter* waiter);
+
+    SpinMutex _lock;
+    Waiter* _head;
+    Waiter* _tail;
+    std::atomic<unsigned int> _count;
+};
+
+}
+
+#endif // _FIBERWAITLIST_H_
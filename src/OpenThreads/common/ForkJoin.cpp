@@ -0,0 +1,139 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/ForkJoin>
+#include <OpenThreads/Backoff>
+#include <OpenThreads/Fiber>
+#include "WorkStealingDeque.h"
+#include <assert.h>
+using namespace OpenThreads;
+
+
+namespace {
+
+// Runs the function given to ForkJoin::run() on a worker
+class RootTask : public Task
+{
+public:
+	RootTask(const std::function<void()>& function) : _function(function), _ran(false) {}
+
+	virtual void execute(TaskContext&)
+	{
+		_function();
+		_ran = true;
+		_done.release();
+	}
+
+	// Dropped by a worker stopping without finishing its tasks
+	virtual void discard() { _done.release(); }
+
+	// Returns false if the task was dropped without running
+	bool wait()
+	{
+		_done.block();
+		return _ran;
+	}
+
+private:
+	const std::function<void()>& _function;
+	bool _ran;
+	Block _done;
+};
+
+}
+
+ForkJoin::ForkJoin()
+	: _worker(nullptr), _task(nullptr), _last(nullptr)
+{
+	// A fiber may be suspended between spawn() and sync(), while other
+	// tasks use the worker's deque: it runs its frames itself.
+	TaskContext* context = TaskContext::current();
+	if (context && !Fiber::isFiber())
+	{
+		_worker = context->getWorker();
+		_task = context->getTask();
+	}
+}
+
+ForkJoin::~ForkJoin()
+{
+	sync();
+}
+
+void ForkJoin::spawn(ForkJoinFrame& frame)
+{
+	if (_worker == nullptr || !_worker->_spawned->push(&frame))
+	{
+		frame.invoke();
+		return;
+	}
+	frame._task = _task;
+	frame._previous = _last;
+	_last = &frame;
+
+	// Pairs with the idle workers announcing themselves before a last look
+	// at the deques
+	ThreadPool* pool = _worker->_pool;
+	if (!pool->_forkJoinUsed.load(std::memory_order_relaxed))
+		pool->enableStealing();
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (pool->_idleWorkers.load(std::memory_order_relaxed) > 0)
+		pool->wakeIdleWorker();
+}
+
+void ForkJoin::sync()
+{
+	while (_last)
+	{
+		ForkJoinFrame* frame = _last;
+		_last = frame->_previous;
+
+		// Frames are popped in the reverse order of their spawning, and the
+		// frames spawned by those run meanwhile have been synced already, so
+		// the bottom of the deque is this frame unless it has been stolen.
+		ForkJoinFrame* popped = _worker->_spawned->pop();
+		if (popped)
+		{
+			assert(popped == frame);
+			frame->invoke();
+			continue;
+		}
+
+		// Stolen, as are the frames spawned before it: help the thieves
+		// rather than block until they are done
+		Backoff backoff;
+		while (!frame->_done.load(std::memory_order_acquire))
+		{
+			if (_worker->runStolen())
+				backoff.reset();
+			else
+				backoff.pause();
+		}
+	}
+}
+
+void ForkJoin::run(ThreadPool& pool, const std::function<void()>& function)
+{
+	TaskContext* context = TaskContext::current();
+	if (context && context->getWorker() && context->getPool() == &pool)
+	{
+		function();
+		return;
+	}
+
+	// Run on the calling thread if the pool does not take the task, or
+	// drops it when stopped
+	RootTask task(function);
+	if (!pool.submit(&task) || !task.wait())
+		function();
+}
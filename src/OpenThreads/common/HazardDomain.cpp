@@ -0,0 +1,275 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/HazardDomain>
+#include <OpenThreads/Backoff>
+#include "ThreadRecords.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <vector>
+
+using namespace OpenThreads;
+
+namespace {
+
+struct Retired
+{
+    Retired(void* p, HazardDomain::Deleter d) : ptr(p), deleter(d) {}
+
+    void* ptr;
+    HazardDomain::Deleter deleter;
+};
+
+void freeAll(std::vector<Retired>& retired)
+{
+    for (size_t i = 0; i < retired.size(); ++i)
+        retired[i].deleter(retired[i].ptr);
+}
+
+}
+
+//-----------------------------------------------------------------------------
+// A block of slots. Blocks are never unlinked before the domain goes away,
+// so scans can read the slots of every block without synchronization. A
+// block belongs to the thread that has set inUse; only that thread touches
+// freeSlots, retired and overflow. The first block of a thread holds
+// everything the thread retires; overflow links the extra blocks it took
+// when it needed more slots at once.
+//
+struct HazardDomain::Record
+{
+    Record(unsigned int count)
+        : slots(new std::atomic<void*>[count]), slotCount(count), inUse(true), next(0), overflow(0)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            slots[i].store(0, std::memory_order_relaxed);
+            freeSlots.push_back(count - 1 - i);
+        }
+    }
+
+    ~Record() { delete [] slots; }
+
+    std::atomic<void*>* slots;
+    unsigned int slotCount;
+
+    std::atomic<bool> inUse;
+    Record* next;
+    Record* overflow;
+
+    std::vector<unsigned int> freeSlots;
+    std::vector<Retired> retired;
+
+    char pad[OPENTHREADS_CACHE_LINE_SIZE];
+};
+
+HazardDomain::HazardDomain(unsigned int slotsPerThread, unsigned int scanThreshold)
+    : _records(0), _recordCount(0),
+      _slotsPerThread(slotsPerThread > 0 ? slotsPerThread : 1),
+      _scanThreshold(scanThreshold > 0 ? scanThreshold : 1)
+{
+    _serial = ThreadRecords::registerOwner(this);
+}
+
+HazardDomain::~HazardDomain()
+{
+    ThreadRecords::unregisterOwner(this);
+
+    Record* record = _records.load(std::memory_order_acquire);
+    while (record)
+    {
+        Record* next = record->next;
+        assert(record->freeSlots.size() == record->slotCount || !record->inUse.load());
+        freeAll(record->retired);
+        delete record;
+        record = next;
+    }
+}
+
+HazardDomain& HazardDomain::instance()
+{
+    static HazardDomain s_domain;
+    return s_domain;
+}
+
+HazardDomain::Record* HazardDomain::acquireRecord()
+{
+    // Reuse the block of an exited thread if there is one.
+    Record* record = _records.load(std::memory_order_acquire);
+    for (; record; record = record->next)
+    {
+        bool expected = false;
+        if (!record->inUse.load(std::memory_order_relaxed) &&
+            record->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            return record;
+    }
+
+    record = new Record(_slotsPerThread);
+    Record* head = _records.load(std::memory_order_relaxed);
+    do
+    {
+        record->next = head;
+    }
+    while (!_records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+    _recordCount.fetch_add(1, std::memory_order_relaxed);
+    return record;
+}
+
+HazardDomain::Record* HazardDomain::getRecord()
+{
+    Record* record = static_cast<Record*>(ThreadRecords::find(this, _serial));
+    if (!record)
+    {
+        record = acquireRecord();
+        ThreadRecords::add(this, _serial, record, &HazardDomain::threadExited);
+    }
+    return record;
+}
+
+void HazardDomain::threadExited(void* domain, void* record)
+{
+    (void)domain;
+
+    // Whatever the thread retired stays in its first block, for the next
+    // owner or for collect() to free.
+    Record* r = static_cast<Record*>(record);
+    while (r)
+    {
+        Record* overflow = r->overflow;
+        r->overflow = 0;
+        r->freeSlots.clear();
+        for (unsigned int i = 0; i < r->slotCount; ++i)
+        {
+            r->slots[i].store(0, std::memory_order_relaxed);
+            r->freeSlots.push_back(r->slotCount - 1 - i);
+        }
+        r->inUse.store(false, std::memory_order_release);
+        r = overflow;
+    }
+}
+
+std::atomic<void*>* HazardDomain::acquireSlot(Record*& record)
+{
+    Record* first = getRecord();
+    record = first;
+    for (;;)
+    {
+        if (!record->freeSlots.empty())
+        {
+            unsigned int index = record->freeSlots.back();
+            record->freeSlots.pop_back();
+            return &record->slots[index];
+        }
+        if (!record->overflow)
+        {
+            // A recycled block may still hold what its last thread retired.
+            Record* overflow = acquireRecord();
+            first->retired.insert(first->retired.end(), overflow->retired.begin(), overflow->retired.end());
+            overflow->retired.clear();
+            record->overflow = overflow;
+        }
+        record = record->overflow;
+    }
+}
+
+void HazardDomain::releaseSlot(Record* record, std::atomic<void*>* slot)
+{
+    slot->store(0, std::memory_order_release);
+    record->freeSlots.push_back((unsigned int)(slot - record->slots));
+}
+
+void HazardDomain::retire(void* ptr, Deleter deleter)
+{
+    if (!ptr)
+        return;
+
+    Record* record = getRecord();
+    record->retired.push_back(Retired(ptr, deleter));
+
+    // Scanning costs one pass over all the slots; waiting for twice that
+    // many retired objects guarantees half of them can be freed.
+    size_t threshold = 2 * (size_t)_recordCount.load(std::memory_order_relaxed) * _slotsPerThread;
+    if (threshold < _scanThreshold)
+        threshold = _scanThreshold;
+    if (record->retired.size() >= threshold)
+        scan(record);
+}
+
+unsigned int HazardDomain::scan(Record* record)
+{
+    // Pairs with the fence in HazardPointer::protect(): a slot published
+    // before the object was unlinked is seen here.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    std::vector<void*> hazards;
+    for (Record* r = _records.load(std::memory_order_acquire); r; r = r->next)
+    {
+        for (unsigned int i = 0; i < r->slotCount; ++i)
+        {
+            void* ptr = r->slots[i].load(std::memory_order_relaxed);
+            if (ptr)
+                hazards.push_back(ptr);
+        }
+    }
+    std::sort(hazards.begin(), hazards.end());
+
+    // Deleters may retire more objects, so run them on a separate list.
+    std::vector<Retired> ready;
+    std::vector<Retired>& retired = record->retired;
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); ++i)
+    {
+        if (std::binary_search(hazards.begin(), hazards.end(), retired[i].ptr))
+            retired[kept++] = retired[i];
+        else
+            ready.push_back(retired[i]);
+    }
+    retired.resize(kept, Retired(0, 0));
+
+    freeAll(ready);
+    return (unsigned int)ready.size();
+}
+
+unsigned int HazardDomain::collect()
+{
+    unsigned int freed = scan(getRecord());
+
+    // Objects left behind by exited threads.
+    for (Record* record = _records.load(std::memory_order_acquire); record; record = record->next)
+    {
+        bool expected = false;
+        if (!record->inUse.load(std::memory_order_relaxed) &&
+            record->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            if (!record->retired.empty())
+                freed += scan(record);
+            record->inUse.store(false, std::memory_order_release);
+        }
+    }
+    return freed;
+}
+
+//-----------------------------------------------------------------------------
+// HazardPointer
+//
+
+HazardPointer::HazardPointer(HazardDomain& domain)
+    : _domain(domain), _record(0), _slot(domain.acquireSlot(_record))
+{
+}
+
+HazardPointer::~HazardPointer()
+{
+    _domain.releaseSlot(_record, _slot);
+}
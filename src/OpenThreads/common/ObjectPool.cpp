@@ -0,0 +1,379 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/ObjectPool>
+#include <OpenThreads/Backoff>
+#include "ThreadRecords.h"
+
+using namespace OpenThreads;
+
+namespace {
+
+struct FreeBlock
+{
+    FreeBlock* next;
+};
+
+// Batches in the depot of one block size.
+const unsigned int DEPOT_SLOTS = 32;
+
+void freeBlocks(FreeBlock* block)
+{
+    while (block)
+    {
+        FreeBlock* next = block->next;
+        ::operator delete(block);
+        block = next;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Full batches shared by the threads. A batch is a list of blocks linked
+// through their first word. Taking a batch exchanges its slot with null,
+// so no thread ever follows a link another thread may be changing.
+//
+class BatchDepot
+{
+public:
+    // Return false if every slot is taken.
+    bool push(FreeBlock* batch)
+    {
+        for (unsigned int i = 0; i < DEPOT_SLOTS; ++i)
+        {
+            FreeBlock* expected = 0;
+            if (_slots[i].load(std::memory_order_relaxed) == 0 &&
+                _slots[i].compare_exchange_strong(expected, batch, std::memory_order_release, std::memory_order_relaxed))
+            {
+                _count.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Return a batch, or 0 if the depot is empty.
+    FreeBlock* pop()
+    {
+        if (_count.load(std::memory_order_relaxed) == 0)
+            return 0;
+        for (unsigned int i = 0; i < DEPOT_SLOTS; ++i)
+        {
+            if (_slots[i].load(std::memory_order_relaxed) == 0)
+                continue;
+            FreeBlock* batch = _slots[i].exchange(0, std::memory_order_acquire);
+            if (batch)
+            {
+                _count.fetch_sub(1, std::memory_order_relaxed);
+                return batch;
+            }
+        }
+        return 0;
+    }
+
+    void clear()
+    {
+        for (unsigned int i = 0; i < DEPOT_SLOTS; ++i)
+            freeBlocks(_slots[i].exchange(0, std::memory_order_acquire));
+        _count.store(0, std::memory_order_relaxed);
+    }
+
+    // Zero-initialized when static, so usable before any constructor runs.
+    std::atomic<FreeBlock*> _slots[DEPOT_SLOTS];
+    std::atomic<unsigned int> _count;
+};
+
+//-----------------------------------------------------------------------------
+// The blocks of one size a thread keeps. Only touched by its thread.
+//
+struct FreeList
+{
+    FreeBlock* head;
+    unsigned int count;
+    size_t blockSize;
+    unsigned int batchSize;
+
+    void init(size_t size, unsigned int batch)
+    {
+        head = 0;
+        count = 0;
+        blockSize = size;
+        batchSize = batch;
+    }
+
+    void* take(BatchDepot& depot)
+    {
+        if (!head)
+        {
+            head = depot.pop();
+            if (!head)
+                return ::operator new(blockSize);
+            count = batchSize;
+        }
+        FreeBlock* block = head;
+        head = block->next;
+        --count;
+        return block;
+    }
+
+    void put(BatchDepot& depot, void* memory)
+    {
+        FreeBlock* block = static_cast<FreeBlock*>(memory);
+        block->next = head;
+        head = block;
+        if (++count < 2 * batchSize)
+            return;
+
+        // Keep one batch, hand the other over
+        FreeBlock* last = head;
+        for (unsigned int i = 1; i < batchSize; ++i)
+            last = last->next;
+        FreeBlock* batch = head;
+        head = last->next;
+        last->next = 0;
+        count -= batchSize;
+        if (!depot.push(batch))
+            freeBlocks(batch);
+    }
+
+    // Hand the full batches over and free the rest.
+    void flush(BatchDepot& depot)
+    {
+        while (count >= batchSize)
+        {
+            FreeBlock* batch = head;
+            FreeBlock* last = head;
+            for (unsigned int i = 1; i < batchSize; ++i)
+                last = last->next;
+            head = last->next;
+            last->next = 0;
+            count -= batchSize;
+            if (!depot.push(batch))
+                freeBlocks(batch);
+        }
+        freeBlocks(head);
+        head = 0;
+        count = 0;
+    }
+};
+
+//-----------------------------------------------------------------------------
+// TaskAllocator's size classes: multiples of 32 bytes up to 1 KB, then of
+// 256 bytes up to MAX_SIZE.
+//
+const size_t SMALL_STEP = 32;
+const size_t SMALL_LIMIT = 1024;
+const size_t LARGE_STEP = 256;
+const unsigned int SIZE_CLASSES = SMALL_LIMIT / SMALL_STEP + (TaskAllocator::MAX_SIZE - SMALL_LIMIT) / LARGE_STEP;
+
+inline unsigned int getSizeClass(size_t size)
+{
+    if (size <= SMALL_LIMIT)
+        return size == 0 ? 0 : (unsigned int)((size - 1) / SMALL_STEP);
+    return (unsigned int)(SMALL_LIMIT / SMALL_STEP + (size - SMALL_LIMIT - 1) / LARGE_STEP);
+}
+
+inline size_t getClassSize(unsigned int sizeClass)
+{
+    if (sizeClass < SMALL_LIMIT / SMALL_STEP)
+        return (sizeClass + 1) * SMALL_STEP;
+    return SMALL_LIMIT + (sizeClass + 1 - SMALL_LIMIT / SMALL_STEP) * LARGE_STEP;
+}
+
+// About 16 KB per batch, between 8 and 64 blocks.
+inline unsigned int getClassBatchSize(unsigned int sizeClass)
+{
+    size_t batch = 16384 / getClassSize(sizeClass);
+    return batch < 8 ? 8 : batch > 64 ? 64 : (unsigned int)batch;
+}
+
+BatchDepot s_depots[SIZE_CLASSES];
+
+struct ThreadCaches
+{
+    ThreadCaches()
+    {
+        for (unsigned int i = 0; i < SIZE_CLASSES; ++i)
+            lists[i].init(getClassSize(i), getClassBatchSize(i));
+    }
+
+    ~ThreadCaches()
+    {
+        for (unsigned int i = 0; i < SIZE_CLASSES; ++i)
+            lists[i].flush(s_depots[i]);
+    }
+
+    FreeList lists[SIZE_CLASSES];
+};
+
+// The calling thread's caches, created on first use. Trivially initialized,
+// so that reading it costs a single thread-local access.
+thread_local ThreadCaches* t_caches = 0;
+
+// Set once the thread's caches are gone: blocks freed by later thread_local
+// destructors go to the heap
+ThreadCaches* const DESTROYED_CACHES = reinterpret_cast<ThreadCaches*>(1);
+
+struct ThreadCachesReaper
+{
+    ~ThreadCachesReaper()
+    {
+        delete t_caches;
+        t_caches = DESTROYED_CACHES;
+    }
+};
+
+thread_local ThreadCachesReaper t_reaper;
+
+// Return the calling thread's caches, or 0 once they are destroyed.
+ThreadCaches* getThreadCaches()
+{
+    ThreadCaches* caches = t_caches;
+    if (caches == DESTROYED_CACHES)
+        return 0;
+    if (!caches)
+    {
+        // Touching the reaper registers its destructor
+        (void)&t_reaper;
+        caches = t_caches = new ThreadCaches;
+    }
+    return caches;
+}
+
+}
+
+//-----------------------------------------------------------------------------
+// A thread's cache in an ObjectPoolBase. Caches are never unlinked before
+// the pool goes away; one belongs to the thread that has set inUse.
+//
+struct ObjectPoolBase::Cache
+{
+    Cache(size_t blockSize, unsigned int batchSize) : inUse(true), next(0)
+    {
+        list.init(blockSize, batchSize);
+    }
+
+    FreeList list;
+    std::atomic<bool> inUse;
+    Cache* next;
+
+    char pad[OPENTHREADS_CACHE_LINE_SIZE];
+};
+
+struct ObjectPoolBase::Depot : public BatchDepot
+{
+    Depot()
+    {
+        for (unsigned int i = 0; i < DEPOT_SLOTS; ++i)
+            _slots[i].store(0, std::memory_order_relaxed);
+        _count.store(0, std::memory_order_relaxed);
+    }
+};
+
+ObjectPoolBase::ObjectPoolBase(size_t blockSize, unsigned int batchSize)
+    : _blockSize(blockSize < sizeof(FreeBlock) ? sizeof(FreeBlock) : blockSize),
+      _batchSize(batchSize > 0 ? batchSize : 1),
+      _depot(new Depot),
+      _caches(0)
+{
+    _serial = ThreadRecords::registerOwner(this);
+}
+
+ObjectPoolBase::~ObjectPoolBase()
+{
+    ThreadRecords::unregisterOwner(this);
+
+    Cache* cache = _caches.load(std::memory_order_acquire);
+    while (cache)
+    {
+        Cache* next = cache->next;
+        freeBlocks(cache->list.head);
+        delete cache;
+        cache = next;
+    }
+    _depot->clear();
+    delete _depot;
+}
+
+ObjectPoolBase::Cache* ObjectPoolBase::getCache()
+{
+    Cache* cache = static_cast<Cache*>(ThreadRecords::find(this, _serial));
+    if (cache)
+        return cache;
+
+    // Take over the cache of an exited thread if there is one, blocks and all
+    for (cache = _caches.load(std::memory_order_acquire); cache; cache = cache->next)
+    {
+        bool expected = false;
+        if (!cache->inUse.load(std::memory_order_relaxed) &&
+            cache->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            break;
+    }
+
+    if (!cache)
+    {
+        cache = new Cache(_blockSize, _batchSize);
+        Cache* head = _caches.load(std::memory_order_relaxed);
+        do
+        {
+            cache->next = head;
+        }
+        while (!_caches.compare_exchange_weak(head, cache, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    ThreadRecords::add(this, _serial, cache, &ObjectPoolBase::threadExited);
+    return cache;
+}
+
+void ObjectPoolBase::threadExited(void* pool, void* cache)
+{
+    (void)pool;
+    static_cast<Cache*>(cache)->inUse.store(false, std::memory_order_release);
+}
+
+void* ObjectPoolBase::allocate()
+{
+    return getCache()->list.take(*_depot);
+}
+
+void ObjectPoolBase::deallocate(void* block)
+{
+    if (block)
+        getCache()->list.put(*_depot, block);
+}
+
+void* TaskAllocator::allocate(size_t size)
+{
+    if (size > MAX_SIZE)
+        return ::operator new(size);
+
+    unsigned int sizeClass = getSizeClass(size);
+    ThreadCaches* caches = getThreadCaches();
+    if (!caches)
+        return ::operator new(getClassSize(sizeClass));
+    return caches->lists[sizeClass].take(s_depots[sizeClass]);
+}
+
+void TaskAllocator::deallocate(void* block, size_t size)
+{
+    if (!block)
+        return;
+    ThreadCaches* caches = size <= MAX_SIZE ? getThreadCaches() : 0;
+    if (!caches)
+    {
+        ::operator delete(block);
+        return;
+    }
+
+    unsigned int sizeClass = getSizeClass(size);
+    caches->lists[sizeClass].put(s_depots[sizeClass], block);
+}
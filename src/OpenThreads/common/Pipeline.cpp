@@ -0,0 +1,315 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/Pipeline>
+#include <OpenThreads/ScopedLock>
+#include <assert.h>
+#include <deque>
+#include <map>
+using namespace OpenThreads;
+
+
+// A token carries one item through the stages. It is a Task so that it can
+// be handed to the pool whenever it becomes runnable again.
+class Pipeline::Token : public Task
+{
+public:
+	Token(Pipeline* pipeline)
+		: _pipeline(pipeline), item(nullptr), stage(0), sequence(0), admitted(false) {}
+
+	virtual void execute(TaskContext&) { _pipeline->runToken(this); }
+	// Dropped by a worker stopping without finishing its tasks
+	virtual void discard() { _pipeline->runInline(this); }
+
+private:
+	Pipeline* _pipeline;
+
+public:
+	void* item;
+	size_t stage;
+	unsigned long long sequence;
+	// Set when the token was let into a serial stage on its behalf, while
+	// it was parked in the stage's buffer
+	bool admitted;
+};
+
+// Bookkeeping of a serial stage
+struct Pipeline::StageState
+{
+	StageState() : busy(false), nextSequence(0) {}
+
+	Mutex mutex;
+	bool busy;
+	unsigned long long nextSequence;
+	std::map<unsigned long long, Token*> reorder;	// SERIAL_IN_ORDER
+	std::deque<Token*> waiting;						// SERIAL_OUT_OF_ORDER
+};
+
+namespace {
+
+class FunctionStage : public PipelineStage
+{
+public:
+	FunctionStage(Mode mode, const std::function<void*(void*)>& function)
+		: PipelineStage(mode), _function(function) {}
+
+	virtual void* process(void* item) { return _function(item); }
+
+private:
+	std::function<void*(void*)> _function;
+};
+
+}
+
+
+Pipeline::Pipeline(ThreadPool& pool)
+	: _pool(pool), _startedTokens(0), _activeTokens(0), _inputDone(false), _inputBusy(false), _nextSequence(0)
+{
+}
+
+Pipeline::~Pipeline()
+{
+	assert(_activeTokens == 0);
+}
+
+void Pipeline::add(PipelineStage* stage)
+{
+	assert(stage);
+	_stages.push_back(stage);
+	_states.push_back(std::unique_ptr<StageState>(new StageState));
+}
+
+void Pipeline::add(PipelineStage::Mode mode, const std::function<void*(void*)>& function)
+{
+	_ownedStages.push_back(std::unique_ptr<PipelineStage>(new FunctionStage(mode, function)));
+	add(_ownedStages.back().get());
+}
+
+unsigned long long Pipeline::run(unsigned int maxTokens)
+{
+	assert(!_stages.empty());
+	if (_stages.empty())
+		return 0;
+	if (maxTokens == 0)
+		maxTokens = 1;
+
+	Token* first;
+	{
+		ScopedLock<Mutex> slock(_mutex);
+		assert(_activeTokens == 0);
+
+		_tokens.clear();
+		for (unsigned int i = 0; i < maxTokens; ++i)
+			_tokens.push_back(std::unique_ptr<Token>(new Token(this)));
+		for (size_t i = 0; i < _states.size(); ++i)
+		{
+			_states[i]->busy = false;
+			_states[i]->nextSequence = 0;
+		}
+		_idleTokens.clear();
+		_inlineTokens.clear();
+		_inputDone = false;
+		_inputBusy = false;
+		_nextSequence = 0;
+
+		// Tokens are started one at a time, as the input produces items
+		_startedTokens = 1;
+		_activeTokens = 1;
+		first = _tokens[0].get();
+	}
+	submit(first);
+
+	ScopedLock<Mutex> slock(_mutex);
+	while (_activeTokens > 0)
+	{
+		if (_inlineTokens.empty())
+		{
+			_finished.wait(&_mutex);
+			continue;
+		}
+		Token* token = _inlineTokens.back();
+		_inlineTokens.pop_back();
+		ReverseScopedLock<Mutex> sunlock(_mutex);
+		runToken(token);
+	}
+	return _nextSequence;
+}
+
+void Pipeline::runToken(Token* token)
+{
+	while (1)
+	{
+		if (token->stage == 0 && !fetchInput(token))
+			return;
+
+		while (token->stage < _stages.size())
+		{
+			PipelineStage* stage = _stages[token->stage];
+			if (stage->getMode() == PipelineStage::PARALLEL)
+			{
+				token->item = stage->process(token->item);
+			}
+			else
+			{
+				StageState& state = *_states[token->stage];
+				if (!enterStage(token, state))
+					return;	// Parked; resubmitted by whoever leaves the stage
+				token->item = stage->process(token->item);
+				leaveStage(token, state);
+			}
+			++token->stage;
+		}
+
+		// Through all the stages: go back for another item
+		token->stage = 0;
+		token->item = nullptr;
+	}
+}
+
+bool Pipeline::fetchInput(Token* token)
+{
+	{
+		ScopedLock<Mutex> slock(_mutex);
+		if (_inputDone)
+		{
+			retire(token);
+			return false;
+		}
+		if (_inputBusy)
+		{
+			_idleTokens.push_back(token);
+			return false;
+		}
+		_inputBusy = true;
+	}
+
+	void* item = _stages[0]->process(nullptr);
+
+	Token* other = nullptr;
+	{
+		ScopedLock<Mutex> slock(_mutex);
+		_inputBusy = false;
+		if (item == nullptr)
+		{
+			_inputDone = true;
+			retire(token);
+			for (size_t i = 0; i < _idleTokens.size(); ++i)
+				retire(_idleTokens[i]);
+			_idleTokens.clear();
+			return false;
+		}
+
+		token->item = item;
+		token->sequence = _nextSequence++;
+		token->stage = 1;
+
+		// Let another token fetch the next item meanwhile
+		if (!_idleTokens.empty())
+		{
+			other = _idleTokens.back();
+			_idleTokens.pop_back();
+		}
+		else if (_startedTokens < _tokens.size())
+		{
+			other = _tokens[_startedTokens++].get();
+			++_activeTokens;
+		}
+	}
+	if (other)
+		submit(other);
+	return true;
+}
+
+bool Pipeline::enterStage(Token* token, StageState& state)
+{
+	if (token->admitted)
+	{
+		token->admitted = false;
+		return true;
+	}
+
+	ScopedLock<Mutex> slock(state.mutex);
+	if (_stages[token->stage]->getMode() == PipelineStage::SERIAL_IN_ORDER)
+	{
+		if (!state.busy && token->sequence == state.nextSequence)
+		{
+			state.busy = true;
+			return true;
+		}
+		state.reorder[token->sequence] = token;
+	}
+	else
+	{
+		if (!state.busy)
+		{
+			state.busy = true;
+			return true;
+		}
+		state.waiting.push_back(token);
+	}
+	return false;
+}
+
+void Pipeline::leaveStage(Token* token, StageState& state)
+{
+	Token* next = nullptr;
+	{
+		ScopedLock<Mutex> slock(state.mutex);
+		if (_stages[token->stage]->getMode() == PipelineStage::SERIAL_IN_ORDER)
+		{
+			++state.nextSequence;
+			std::map<unsigned long long, Token*>::iterator it = state.reorder.find(state.nextSequence);
+			if (it != state.reorder.end())
+			{
+				next = it->second;
+				state.reorder.erase(it);
+			}
+		}
+		else if (!state.waiting.empty())
+		{
+			next = state.waiting.front();
+			state.waiting.pop_front();
+		}
+
+		// The stage stays busy on behalf of the next token
+		if (next)
+			next->admitted = true;
+		else
+			state.busy = false;
+	}
+	if (next)
+		submit(next);
+}
+
+void Pipeline::retire(Token* token)
+{
+	// Called with _mutex held
+	(void)token;
+	assert(_activeTokens > 0);
+	if (--_activeTokens == 0)
+		_finished.broadcast();
+}
+
+void Pipeline::submit(Token* token)
+{
+	if (!_pool.submit(token))
+		runInline(token);
+}
+
+void Pipeline::runInline(Token* token)
+{
+	// The pool is stopping: hand the token to the thread waiting in run()
+	ScopedLock<Mutex> slock(_mutex);
+	_inlineTokens.push_back(token);
+	_finished.broadcast();
+}
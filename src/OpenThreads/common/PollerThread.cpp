@@ -0,0 +1,315 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/PollerThread>
+#include <OpenThreads/Backoff>
+#include <OpenThreads/Clock>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <atomic>
+#include <vector>
+
+using namespace OpenThreads;
+
+namespace {
+
+//-----------------------------------------------------------------------------
+// Latencies in nanoseconds, in buckets of 1 ns up to 16 ns, then 8 buckets
+// per power of two: the upper bound of a bucket is within 12.5% of any
+// value in it.
+//
+const unsigned int LINEAR_BUCKETS = 16;
+const unsigned int SUB_BUCKETS = 8;
+const unsigned int HISTOGRAM_BUCKETS = LINEAR_BUCKETS + (64 - 4) * SUB_BUCKETS;
+
+unsigned int getBucket(unsigned long long value)
+{
+    if (value < LINEAR_BUCKETS)
+        return (unsigned int)value;
+    unsigned int exponent = 63;
+    while (!(value >> exponent))
+        --exponent;
+    unsigned int sub = (unsigned int)(value >> (exponent - 3)) & (SUB_BUCKETS - 1);
+    return LINEAR_BUCKETS + (exponent - 4) * SUB_BUCKETS + sub;
+}
+
+unsigned long long getBucketUpperBound(unsigned int bucket)
+{
+    if (bucket < LINEAR_BUCKETS)
+        return bucket;
+    unsigned int exponent = (bucket - LINEAR_BUCKETS) / SUB_BUCKETS + 4;
+    unsigned long long sub = (bucket - LINEAR_BUCKETS) % SUB_BUCKETS;
+    unsigned long long width = 1ULL << (exponent - 3);
+    return (1ULL << exponent) + (sub + 1) * width - 1;
+}
+
+// Counters written by the poller only, read by any thread
+typedef std::atomic<unsigned long long> Counter;
+
+inline void increment(Counter& counter, unsigned long long n = 1)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+}
+
+struct PollerThread::State
+{
+    State() : stopping(false), parked(false), resetRequested(false), notified(0)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        rounds.store(0, std::memory_order_relaxed);
+        idleRounds.store(0, std::memory_order_relaxed);
+        items.store(0, std::memory_order_relaxed);
+        parks.store(0, std::memory_order_relaxed);
+        busyCycles.store(0, std::memory_order_relaxed);
+        idleCycles.store(0, std::memory_order_relaxed);
+        wakeups.store(0, std::memory_order_relaxed);
+        latencyMax.store(0, std::memory_order_relaxed);
+        for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+            histogram[i].store(0, std::memory_order_relaxed);
+    }
+
+    void record(unsigned long long latency)
+    {
+        increment(histogram[getBucket(latency)]);
+        increment(wakeups);
+        if (latency > latencyMax.load(std::memory_order_relaxed))
+            latencyMax.store(latency, std::memory_order_relaxed);
+    }
+
+    std::vector<PollSource*> sources;
+
+    std::atomic<bool> stopping;
+    std::atomic<bool> parked;
+    // Set by resetStatistics() for the poller to clear the counters
+    std::atomic<bool> resetRequested;
+    // Cycle counter at the oldest notify() not measured yet, or 0
+    std::atomic<unsigned long long> notified;
+
+    Mutex mutex;
+    Condition condition;
+
+    Counter rounds;
+    Counter idleRounds;
+    Counter items;
+    Counter parks;
+    Counter busyCycles;
+    Counter idleCycles;
+    Counter wakeups;
+    Counter latencyMax;
+    Counter histogram[HISTOGRAM_BUCKETS];
+};
+
+PollerThread::PollerThread()
+    : Thread(), _parkAfter(0), _state(new State)
+{
+}
+
+PollerThread::~PollerThread()
+{
+    if (isRunning())
+    {
+        stop();
+        join();
+    }
+    delete _state;
+}
+
+void PollerThread::addSource(PollSource* source)
+{
+    _state->sources.push_back(source);
+}
+
+void PollerThread::notify()
+{
+    unsigned long long stamp = Clock::cycles();
+    unsigned long long expected = 0;
+    _state->notified.compare_exchange_strong(expected, stamp != 0 ? stamp : 1, std::memory_order_seq_cst);
+
+    // Either the poller sees the notification before parking, or this
+    // sees it parked
+    if (_state->parked.load(std::memory_order_seq_cst))
+    {
+        ScopedLock<Mutex> lock(_state->mutex);
+        _state->parked.store(false, std::memory_order_relaxed);
+        _state->condition.signal();
+    }
+}
+
+void PollerThread::stop()
+{
+    _state->stopping.store(true, std::memory_order_relaxed);
+
+    ScopedLock<Mutex> lock(_state->mutex);
+    _state->parked.store(false, std::memory_order_relaxed);
+    _state->condition.signal();
+}
+
+bool PollerThread::isParked() const
+{
+    return _state->parked.load(std::memory_order_relaxed);
+}
+
+bool PollerThread::park()
+{
+    State& s = *_state;
+    s.parked.store(true, std::memory_order_seq_cst);
+    if (s.notified.load(std::memory_order_seq_cst) != 0 || s.stopping.load(std::memory_order_relaxed) ||
+        s.resetRequested.load(std::memory_order_seq_cst))
+    {
+        s.parked.store(false, std::memory_order_relaxed);
+        return false;
+    }
+
+    ScopedLock<Mutex> lock(s.mutex);
+    while (s.parked.load(std::memory_order_relaxed) && !s.stopping.load(std::memory_order_relaxed))
+        s.condition.wait(&s.mutex);
+    s.parked.store(false, std::memory_order_relaxed);
+    increment(s.parks);
+    return true;
+}
+
+void PollerThread::run()
+{
+    State& s = *_state;
+    s.resetRequested.store(false, std::memory_order_relaxed);
+    s.reset();
+
+    double nanosecondsPerCycle = 1.0 / Clock::getCyclesPerNanosecond();
+    unsigned long long parkCycles = (unsigned long long)(_parkAfter * 1000.0 * Clock::getCyclesPerNanosecond());
+
+    unsigned long long last = Clock::cycles();
+    unsigned long long idleSince = last;
+    // The notification seen at the end of the previous round: its item was
+    // visible for this round to handle, if no earlier one did
+    unsigned long long pending = 0;
+
+    while (!s.stopping.load(std::memory_order_relaxed))
+    {
+        if (s.resetRequested.load(std::memory_order_relaxed) && s.resetRequested.exchange(false, std::memory_order_relaxed))
+            s.reset();
+
+        unsigned int handled = 0;
+        for (size_t i = 0; i < s.sources.size(); ++i)
+            handled += s.sources[i]->poll();
+
+        unsigned long long now = Clock::cycles();
+        increment(s.rounds);
+        if (handled > 0)
+        {
+            increment(s.items, handled);
+            increment(s.busyCycles, now - last);
+            idleSince = now;
+        }
+        else
+        {
+            increment(s.idleRounds);
+            increment(s.idleCycles, now - last);
+        }
+
+        if (pending != 0)
+        {
+            s.record(now > pending ? (unsigned long long)((now - pending) * nanosecondsPerCycle) : 0);
+            pending = 0;
+        }
+        if (s.notified.load(std::memory_order_relaxed) != 0)
+            pending = s.notified.exchange(0, std::memory_order_acquire);
+
+        if (handled == 0)
+        {
+            if (parkCycles > 0 && pending == 0 && now - idleSince >= parkCycles && park())
+                idleSince = now = Clock::cycles();
+            else
+                CpuRelax();
+        }
+        last = now;
+    }
+
+    // Ready to be started again
+    s.stopping.store(false, std::memory_order_relaxed);
+}
+
+PollerThread::Statistics PollerThread::getStatistics() const
+{
+    const State& s = *_state;
+    Statistics stats;
+    stats.rounds = s.rounds.load(std::memory_order_relaxed);
+    stats.idleRounds = s.idleRounds.load(std::memory_order_relaxed);
+    stats.items = s.items.load(std::memory_order_relaxed);
+    stats.parks = s.parks.load(std::memory_order_relaxed);
+
+    unsigned long long busy = s.busyCycles.load(std::memory_order_relaxed);
+    unsigned long long idle = s.idleCycles.load(std::memory_order_relaxed);
+    stats.idleRatio = busy + idle > 0 ? (double)idle / (double)(busy + idle) : 0.0;
+
+    stats.wakeups = s.wakeups.load(std::memory_order_relaxed);
+    stats.latency50 = getWakeupLatency(0.5);
+    stats.latency90 = getWakeupLatency(0.9);
+    stats.latency99 = getWakeupLatency(0.99);
+    stats.latency999 = getWakeupLatency(0.999);
+    stats.latencyMax = s.latencyMax.load(std::memory_order_relaxed);
+    return stats;
+}
+
+unsigned long long PollerThread::getWakeupLatency(double fraction) const
+{
+    const State& s = *_state;
+    unsigned long long total = 0;
+    for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+        total += s.histogram[i].load(std::memory_order_relaxed);
+    if (total == 0)
+        return 0;
+
+    unsigned long long rank = (unsigned long long)(fraction * (double)total);
+    if (rank >= total)
+        rank = total - 1;
+    unsigned long long seen = 0;
+    for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+        seen += s.histogram[i].load(std::memory_order_relaxed);
+        if (seen > rank)
+        {
+            unsigned long long bound = getBucketUpperBound(i);
+            unsigned long long max = s.latencyMax.load(std::memory_order_relaxed);
+            return bound < max ? bound : max;
+        }
+    }
+    return s.latencyMax.load(std::memory_order_relaxed);
+}
+
+void PollerThread::resetStatistics()
+{
+    State& s = *_state;
+    if (!isRunning())
+    {
+        s.reset();
+        return;
+    }
+
+    // Either the poller sees the request before parking, or this sees it
+    // parked
+    s.resetRequested.store(true, std::memory_order_seq_cst);
+    if (s.parked.load(std::memory_order_seq_cst))
+    {
+        ScopedLock<Mutex> lock(s.mutex);
+        s.parked.store(false, std::memory_order_relaxed);
+        s.condition.signal();
+    }
+}
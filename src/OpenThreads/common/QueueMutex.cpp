@@ -0,0 +1,191 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/QueueMutex>
+#include <OpenThreads/Backoff>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+#include <assert.h>
+#include <errno.h>
+
+using namespace OpenThreads;
+
+//-----------------------------------------------------------------------------
+// A waiter spins on 'state' until its predecessor sets it to GRANTED. If it
+// gives up spinning it moves the state to PARKED and sleeps on 'condition';
+// the releaser then has to wake it up through 'woken', under 'mutex'.
+// The waiter only returns once it has seen 'woken' under the mutex, so the
+// releaser never touches a node that has been recycled.
+//
+struct QueueMutex::Node
+{
+    enum State { WAITING, GRANTED, PARKED };
+
+    Node() : next(0), state(WAITING), woken(false), freeNext(0) {}
+
+    std::atomic<Node*> next;
+    std::atomic<int> state;
+
+    Mutex mutex;
+    Condition condition;
+    bool woken;
+
+    Node* freeNext;
+
+    char pad[OPENTHREADS_CACHE_LINE_SIZE];
+};
+
+namespace {
+
+// Nodes are kept in a per-thread free list. A thread needs one node per
+// QueueMutex it is holding or waiting for, so the list stays tiny.
+struct NodeCache
+{
+    NodeCache() : head(0) {}
+    ~NodeCache()
+    {
+        while (head)
+        {
+            QueueMutex::Node* node = head;
+            head = node->freeNext;
+            delete node;
+        }
+    }
+
+    QueueMutex::Node* acquire()
+    {
+        QueueMutex::Node* node = head;
+        if (node)
+            head = node->freeNext;
+        else
+            node = new QueueMutex::Node;
+        node->next.store(0, std::memory_order_relaxed);
+        node->state.store(QueueMutex::Node::WAITING, std::memory_order_relaxed);
+        node->woken = false;
+        return node;
+    }
+
+    void release(QueueMutex::Node* node)
+    {
+        node->freeNext = head;
+        head = node;
+    }
+
+    QueueMutex::Node* head;
+};
+
+thread_local NodeCache t_nodes;
+
+unsigned int defaultSpinCount()
+{
+    // Spinning only makes sense if the lock holder can run meanwhile.
+    static const unsigned int s_spinCount = GetNumberOfProcessors() > 1 ? 2000 : 0;
+    return s_spinCount;
+}
+
+}
+
+QueueMutex::QueueMutex(int spinCount)
+    : _tail(0), _owner(0), _spinCount(spinCount < 0 ? defaultSpinCount() : (unsigned int)spinCount)
+{
+}
+
+QueueMutex::~QueueMutex()
+{
+    assert(_tail.load() == 0);
+}
+
+int QueueMutex::lock()
+{
+    Node* node = t_nodes.acquire();
+
+    Node* pred = _tail.exchange(node, std::memory_order_acq_rel);
+    if (pred)
+    {
+        pred->next.store(node, std::memory_order_release);
+
+        bool granted = false;
+        for (unsigned int i = 0; i < _spinCount; ++i)
+        {
+            if (node->state.load(std::memory_order_acquire) == Node::GRANTED)
+            {
+                granted = true;
+                break;
+            }
+            CpuRelax();
+        }
+
+        int expected = Node::WAITING;
+        if (!granted && node->state.compare_exchange_strong(expected, Node::PARKED, std::memory_order_acq_rel))
+        {
+            ScopedLock<Mutex> slock(node->mutex);
+            while (!node->woken)
+                node->condition.wait(&node->mutex);
+        }
+    }
+
+    _owner = node;
+    return 0;
+}
+
+int QueueMutex::trylock()
+{
+    Node* node = t_nodes.acquire();
+    Node* expected = 0;
+    if (!_tail.compare_exchange_strong(expected, node, std::memory_order_acq_rel))
+    {
+        t_nodes.release(node);
+        return EBUSY;
+    }
+
+    _owner = node;
+    return 0;
+}
+
+int QueueMutex::unlock()
+{
+    Node* node = _owner;
+    assert(node);
+    if (!node)
+        return -1;
+    _owner = 0;
+
+    Node* succ = node->next.load(std::memory_order_acquire);
+    if (!succ)
+    {
+        Node* expected = node;
+        if (_tail.compare_exchange_strong(expected, 0, std::memory_order_release, std::memory_order_relaxed))
+        {
+            t_nodes.release(node);
+            return 0;
+        }
+
+        // A waiter has swapped itself in but not linked yet; this only
+        // takes the few instructions between its exchange and its store.
+        Backoff backoff;
+        while ((succ = node->next.load(std::memory_order_acquire)) == 0)
+            backoff.pause();
+    }
+
+    if (succ->state.exchange(Node::GRANTED, std::memory_order_acq_rel) == Node::PARKED)
+    {
+        ScopedLock<Mutex> slock(succ->mutex);
+        succ->woken = true;
+        succ->condition.signal();
+    }
+
+    t_nodes.release(node);
+    return 0;
+}
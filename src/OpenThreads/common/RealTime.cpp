@@ -0,0 +1,449 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/RealTime>
+
+#include <errno.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <malloc.h>
+#define OT_STACK_ALLOCA _alloca
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <alloca.h>
+#define OT_STACK_ALLOCA alloca
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <stdint.h>
+#endif
+
+using namespace OpenThreads;
+
+namespace {
+
+#if defined(__linux__)
+
+#ifndef SCHED_BATCH
+#define SCHED_BATCH 3
+#endif
+#ifndef SCHED_IDLE
+#define SCHED_IDLE 5
+#endif
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+#ifndef SCHED_RESET_ON_FORK
+#define SCHED_RESET_ON_FORK 0x40000000
+#endif
+#ifndef SCHED_FLAG_RESET_ON_FORK
+#define SCHED_FLAG_RESET_ON_FORK 0x01
+#endif
+
+//-----------------------------------------------------------------------------
+// The kernel's struct sched_attr, which older C libraries do not declare,
+// for sched_setattr() and sched_getattr(): SCHED_DEADLINE has no
+// pthread or sched_setscheduler() interface.
+//
+struct DeadlineAttributes
+{
+    uint32_t size;
+    uint32_t policy;
+    uint64_t flags;
+    int32_t nice;
+    uint32_t priority;
+    uint64_t runtime;
+    uint64_t deadline;
+    uint64_t period;
+};
+
+int setDeadlineAttributes(const DeadlineAttributes& attributes)
+{
+#if defined(SYS_sched_setattr)
+    return syscall(SYS_sched_setattr, 0, &attributes, 0) == 0 ? 0 : errno;
+#else
+    (void)attributes;
+    return ENOSYS;
+#endif
+}
+
+int getDeadlineAttributes(DeadlineAttributes& attributes)
+{
+#if defined(SYS_sched_getattr)
+    attributes.size = sizeof(attributes);
+    return syscall(SYS_sched_getattr, 0, &attributes, sizeof(attributes), 0) == 0 ? 0 : errno;
+#else
+    (void)attributes;
+    return ENOSYS;
+#endif
+}
+
+#endif // __linux__
+
+bool isFixedPriority(RealTimeSettings::Policy policy)
+{
+    return policy == RealTimeSettings::POLICY_FIFO || policy == RealTimeSettings::POLICY_ROUND_ROBIN;
+}
+
+#if !defined(_WIN32)
+
+// Return the kernel's policy for policy, or -1 if it has none.
+int toNativePolicy(RealTimeSettings::Policy policy)
+{
+    switch (policy)
+    {
+        case RealTimeSettings::POLICY_OTHER: return SCHED_OTHER;
+        case RealTimeSettings::POLICY_FIFO: return SCHED_FIFO;
+        case RealTimeSettings::POLICY_ROUND_ROBIN: return SCHED_RR;
+#if defined(__linux__)
+        case RealTimeSettings::POLICY_BATCH: return SCHED_BATCH;
+        case RealTimeSettings::POLICY_IDLE: return SCHED_IDLE;
+        case RealTimeSettings::POLICY_DEADLINE: return SCHED_DEADLINE;
+#endif
+        default: return -1;
+    }
+}
+
+RealTimeSettings::Policy fromNativePolicy(int policy)
+{
+#if defined(__linux__)
+    policy &= ~SCHED_RESET_ON_FORK;
+    if (policy == SCHED_BATCH) return RealTimeSettings::POLICY_BATCH;
+    if (policy == SCHED_IDLE) return RealTimeSettings::POLICY_IDLE;
+    if (policy == SCHED_DEADLINE) return RealTimeSettings::POLICY_DEADLINE;
+#endif
+    if (policy == SCHED_FIFO) return RealTimeSettings::POLICY_FIFO;
+    if (policy == SCHED_RR) return RealTimeSettings::POLICY_ROUND_ROBIN;
+    return RealTimeSettings::POLICY_OTHER;
+}
+
+int setScheduling(const RealTimeSettings& settings)
+{
+    int policy = toNativePolicy(settings.policy);
+    if (policy < 0)
+        return ENOSYS;
+
+#if defined(__linux__)
+    if (settings.policy == RealTimeSettings::POLICY_DEADLINE)
+    {
+        DeadlineAttributes attributes = DeadlineAttributes();
+        attributes.size = sizeof(attributes);
+        attributes.policy = SCHED_DEADLINE;
+        attributes.flags = settings.resetOnFork ? SCHED_FLAG_RESET_ON_FORK : 0;
+        attributes.runtime = settings.runtime;
+        attributes.deadline = settings.deadline != 0 ? settings.deadline : settings.period;
+        attributes.period = settings.period != 0 ? settings.period : attributes.deadline;
+        return setDeadlineAttributes(attributes);
+    }
+
+    if (settings.resetOnFork)
+        policy |= SCHED_RESET_ON_FORK;
+#endif
+
+    sched_param param = sched_param();
+    param.sched_priority = isFixedPriority(settings.policy) ? settings.priority : 0;
+    int status = pthread_setschedparam(pthread_self(), policy, &param);
+    if (status != 0)
+        return status;
+
+#if defined(__linux__)
+    // The nice value is per thread on Linux, and shapes the time sharing
+    // policies only
+    if (!isFixedPriority(settings.policy) && settings.policy != RealTimeSettings::POLICY_IDLE)
+    {
+        if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), settings.priority) != 0)
+            return errno == EACCES ? EPERM : errno;
+    }
+#endif
+    return 0;
+}
+
+#endif // !_WIN32
+
+const size_t DEFAULT_PAGE_SIZE = 4096;
+
+size_t getPageSize()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : DEFAULT_PAGE_SIZE;
+#endif
+}
+
+// Get the bounds of the calling thread's stack and the size of the guard
+// below it, if the platform tells; top is 0 where only the bottom is
+// known. Some C libraries count the guard in the stack, so it is kept
+// clear of either way.
+bool getStackBounds(size_t& bottom, size_t& top, size_t& guard)
+{
+    top = 0;
+    guard = 0;
+
+#if defined(_WIN32)
+    // The reservation starts at the bottom of the stack, and the guard
+    // pages that grow it lie above
+    MEMORY_BASIC_INFORMATION info;
+    if (VirtualQuery(&info, &info, sizeof(info)) == 0)
+        return false;
+    bottom = (size_t)info.AllocationBase;
+    guard = 16 * getPageSize();
+    return true;
+#elif defined(__linux__)
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0)
+        return false;
+    void* address = 0;
+    size_t size = 0;
+    pthread_attr_getstack(&attr, &address, &size);
+    pthread_attr_getguardsize(&attr, &guard);
+    pthread_attr_destroy(&attr);
+    bottom = (size_t)address;
+    top = bottom + size;
+    return true;
+#elif defined(__APPLE__)
+    pthread_t self = pthread_self();
+    top = (size_t)pthread_get_stackaddr_np(self);
+    bottom = top - pthread_get_stacksize_np(self);
+    return true;
+#else
+    (void)bottom;
+    return false;
+#endif
+}
+
+// Return the bytes of stack below here that can be touched safely, or
+// limit if the platform does not tell.
+size_t getStackRoom(size_t limit, size_t pageSize)
+{
+    size_t bottom;
+    size_t top;
+    size_t guard;
+    if (!getStackBounds(bottom, top, guard))
+        return limit;
+
+    char here;
+    size_t current = (size_t)&here;
+    size_t margin = guard + pageSize;
+    if (current <= bottom + margin)
+        return 0;
+    size_t room = current - bottom - margin;
+    return room < limit ? room : limit;
+}
+
+}
+
+RealTimeSettings::RealTimeSettings()
+    : policy(POLICY_UNCHANGED), priority(0), runtime(0), deadline(0), period(0),
+      resetOnFork(false), lockMemory(false), prefaultStack(0)
+{
+}
+
+RealTimeResult::RealTimeResult()
+    : schedulingError(0), memoryLockError(0), prefaulted(0),
+      policy(RealTimeSettings::POLICY_OTHER), priority(0)
+{
+}
+
+const char* RealTimeResult::describe() const
+{
+    switch (schedulingError)
+    {
+        case 0: break;
+        case EPERM: return "scheduling refused: the thread needs CAP_SYS_NICE, or an RLIMIT_RTPRIO at least its priority";
+        case EBUSY: return "scheduling refused: deadline admission control found too little bandwidth left";
+        case EINVAL: return "scheduling refused: priority or deadline parameters out of range";
+        case ENOSYS: return "scheduling refused: the policy is not supported here";
+        default: return "scheduling refused";
+    }
+    switch (memoryLockError)
+    {
+        case 0: break;
+        case EPERM: return "memory lock refused: the process needs CAP_IPC_LOCK";
+        case ENOMEM:
+        case EAGAIN: return "memory lock refused: RLIMIT_MEMLOCK is too small";
+        case ENOSYS: return "memory lock refused: not supported here";
+        default: return "memory lock refused";
+    }
+    return "granted";
+}
+
+size_t OpenThreads::PrefaultStackOfCurrentThread(size_t bytes)
+{
+    size_t pageSize = getPageSize();
+    bytes = getStackRoom(bytes, pageSize);
+    if (bytes == 0)
+        return 0;
+
+    // Top down, so that a stack growing page by page behind a guard, as on
+    // Windows, follows
+    volatile char* stack = static_cast<volatile char*>(OT_STACK_ALLOCA(bytes));
+    size_t offset = bytes;
+    while (offset > pageSize)
+    {
+        offset -= pageSize;
+        stack[offset] = 0;
+    }
+    stack[0] = 0;
+    return bytes;
+}
+
+int OpenThreads::LockStackOfCurrentThread()
+{
+#if defined(_WIN32)
+    return ENOSYS;
+#else
+    size_t bottom;
+    size_t top;
+    size_t guard;
+    if (!getStackBounds(bottom, top, guard) || top == 0)
+        return ENOSYS;
+
+#if defined(__linux__)
+    // The stack of the main thread is only mapped as far as it has grown:
+    // lock that much
+    if (syscall(SYS_gettid) == getpid())
+    {
+        char here;
+        size_t pageSize = getPageSize();
+        bottom = (size_t)&here & ~(pageSize - 1);
+        guard = 0;
+    }
+#endif
+
+    bottom += guard;
+    return mlock((void*)bottom, top - bottom) == 0 ? 0 : errno;
+#endif
+}
+
+int OpenThreads::SetRealTimeOfCurrentThread(const RealTimeSettings& settings, RealTimeResult* result)
+{
+    RealTimeResult local;
+    RealTimeResult& r = result ? *result : local;
+    r = RealTimeResult();
+
+#if defined(_WIN32)
+    if (settings.policy != RealTimeSettings::POLICY_UNCHANGED)
+        r.schedulingError = ENOSYS;
+    if (settings.lockMemory)
+        r.memoryLockError = ENOSYS;
+#else
+    if (settings.policy != RealTimeSettings::POLICY_UNCHANGED)
+        r.schedulingError = setScheduling(settings);
+
+    if (settings.lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        r.memoryLockError = errno;
+#endif
+
+    if (settings.prefaultStack > 0)
+        r.prefaulted = PrefaultStackOfCurrentThread(settings.prefaultStack);
+
+    RealTimeSettings granted;
+    if (GetRealTimeOfCurrentThread(granted) == 0)
+    {
+        r.policy = granted.policy;
+        r.priority = granted.priority;
+
+        // A call that returned success but left the thread as it was has
+        // been refused all the same
+        if (r.schedulingError == 0 && settings.policy != RealTimeSettings::POLICY_UNCHANGED &&
+            (granted.policy != settings.policy ||
+             (isFixedPriority(settings.policy) && granted.priority != settings.priority)))
+        {
+            r.schedulingError = EPERM;
+        }
+    }
+
+    return r.schedulingError != 0 ? r.schedulingError : r.memoryLockError;
+}
+
+int OpenThreads::GetRealTimeOfCurrentThread(RealTimeSettings& settings)
+{
+    settings = RealTimeSettings();
+
+#if defined(_WIN32)
+    settings.policy = RealTimeSettings::POLICY_OTHER;
+    settings.priority = GetThreadPriority(GetCurrentThread());
+    return 0;
+#else
+    int policy;
+    sched_param param;
+    int status = pthread_getschedparam(pthread_self(), &policy, &param);
+    if (status != 0)
+        return status;
+
+    settings.policy = fromNativePolicy(policy);
+    settings.priority = param.sched_priority;
+#if defined(__linux__)
+    settings.resetOnFork = (policy & SCHED_RESET_ON_FORK) != 0;
+
+    DeadlineAttributes attributes = DeadlineAttributes();
+    if (getDeadlineAttributes(attributes) == 0)
+    {
+        settings.policy = fromNativePolicy((int)attributes.policy);
+        settings.resetOnFork = (attributes.flags & SCHED_FLAG_RESET_ON_FORK) != 0;
+        if (settings.policy == RealTimeSettings::POLICY_DEADLINE)
+        {
+            settings.runtime = attributes.runtime;
+            settings.deadline = attributes.deadline;
+            settings.period = attributes.period;
+        }
+        else if (!isFixedPriority(settings.policy))
+        {
+            settings.priority = attributes.nice;
+        }
+    }
+#endif
+    return 0;
+#endif
+}
+
+int OpenThreads::GetRealTimePriorityRange(RealTimeSettings::Policy policy, int& minimum, int& maximum)
+{
+    minimum = maximum = 0;
+
+#if defined(_WIN32)
+    (void)policy;
+    return ENOSYS;
+#else
+    if (!isFixedPriority(policy))
+    {
+        // Nice values
+        if (policy == RealTimeSettings::POLICY_OTHER || policy == RealTimeSettings::POLICY_BATCH)
+        {
+            minimum = 19;
+            maximum = -20;
+        }
+        return toNativePolicy(policy) < 0 ? ENOSYS : 0;
+    }
+
+    int native = toNativePolicy(policy);
+    minimum = sched_get_priority_min(native);
+    maximum = sched_get_priority_max(native);
+    if (minimum < 0 || maximum < 0)
+    {
+        minimum = maximum = 0;
+        return errno;
+    }
+    return 0;
+#endif
+}
@@ -0,0 +1,221 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/Strand>
+#include <OpenThreads/Backoff>
+#include <OpenThreads/ScopedLock>
+#include <assert.h>
+using namespace OpenThreads;
+
+
+namespace {
+
+class FunctionTask : public PooledTask
+{
+public:
+	FunctionTask(const std::function<void(TaskContext&)>& function) : _function(function) {}
+
+	virtual void execute(TaskContext& ctxt) { _function(ctxt); }
+
+private:
+	std::function<void(TaskContext&)> _function;
+};
+
+// The strand whose tasks the calling thread is running, if any
+thread_local const Strand* t_currentStrand = nullptr;
+
+}
+
+struct Strand::Node
+{
+	Node(Task* t, bool o) : task(t), owned(o), next(nullptr) {}
+
+	static void* operator new(size_t size) { return TaskAllocator::allocate(size); }
+	static void operator delete(void* node, size_t size) { TaskAllocator::deallocate(node, size); }
+
+	Task* task;
+	bool owned;
+	std::atomic<Node*> next;
+};
+
+void Strand::Runner::execute(TaskContext& ctxt)
+{
+	_strand->drain(ctxt);
+}
+
+void Strand::Runner::discard()
+{
+	// The pool is stopping: leave the tasks to the next post() or wait()
+	// rather than run them on the worker
+	Strand* strand = _strand;
+	ScopedLock<Mutex> slock(strand->_mutex);
+	strand->_lost.store(true, std::memory_order_seq_cst);
+	if (strand->_waiters > 0)
+		strand->_condition.broadcast();
+}
+
+
+Strand::Strand(ThreadPool& pool, ThreadPool::DispatchOp* op)
+	: _pool(pool), _op(op), _runner(this), _batchSize(DEFAULT_BATCH_SIZE), _count(0), _lost(false), _waiters(0)
+{
+	_head = new Node(nullptr, false);
+	_tail.store(_head, std::memory_order_relaxed);
+}
+
+Strand::~Strand()
+{
+	wait();
+	delete _head;
+}
+
+void Strand::post(Task* task)
+{
+	assert(task);
+	push(task, false);
+}
+
+void Strand::post(const std::function<void(TaskContext&)>& function)
+{
+	push(new FunctionTask(function), true);
+}
+
+void Strand::push(Task* task, bool owned)
+{
+	Node* node = new Node(task, owned);
+	Node* previous = _tail.exchange(node, std::memory_order_acq_rel);
+	previous->next.store(node, std::memory_order_release);
+
+	// Counted once linked: the thread running the strand may find the link
+	// of a node it counted missing for a moment, but not the node itself
+	if (_count.fetch_add(1, std::memory_order_seq_cst) == 0)
+		schedule();
+	else
+		takeOverLost();
+}
+
+bool Strand::takeOverLost()
+{
+	if (!_lost.load(std::memory_order_seq_cst) || !_lost.exchange(false, std::memory_order_acquire))
+		return false;
+
+	TaskContext* current = TaskContext::current();
+	TaskContext outsider(&_pool, nullptr);
+	drain(current ? *current : outsider);
+	return true;
+}
+
+void Strand::schedule()
+{
+	if (_pool.submit(&_runner, _op))
+		return;
+
+	// No worker to take it: run the tasks here, as TaskGroup::wait() does
+	TaskContext* current = TaskContext::current();
+	TaskContext outsider(&_pool, nullptr);
+	drain(current ? *current : outsider);
+}
+
+void Strand::drain(TaskContext& ctxt)
+{
+	const Strand* previousStrand = t_currentStrand;
+	t_currentStrand = this;
+
+	for (;;)
+	{
+		unsigned int count = _count.load(std::memory_order_acquire);
+		if (count > _batchSize)
+			count = _batchSize;
+
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			Node* head = _head;
+			Node* next = head->next.load(std::memory_order_acquire);
+			Backoff backoff;
+			while (next == nullptr)
+			{
+				backoff.pause();
+				next = head->next.load(std::memory_order_acquire);
+			}
+			// next becomes the dummy node
+			_head = next;
+			delete head;
+			Task* task = next->task;
+			bool owned = next->owned;
+			next->task = nullptr;
+
+			// Run the task in the caller's context, as the current task
+			Task* previousTask = ctxt._task;
+			TaskContext* previousContext = TaskContext::current();
+			ctxt._task = task;
+			TaskContext::setCurrent(&ctxt);
+			task->execute(ctxt);
+			TaskContext::setCurrent(previousContext);
+			ctxt._task = previousTask;
+
+			if (owned)
+				delete task;
+		}
+
+		// Only this thread lowers the count: above count it cannot drop to
+		// 0 meanwhile, and no lock is needed
+		if (_count.load(std::memory_order_relaxed) > count)
+		{
+			_count.fetch_sub(count, std::memory_order_relaxed);
+		}
+		else
+		{
+			ScopedLock<Mutex> slock(_mutex);
+			if (_count.fetch_sub(count, std::memory_order_acq_rel) == count)
+			{
+				// Idle: the strand may be destroyed as soon as the lock is
+				// released
+				t_currentStrand = previousStrand;
+				if (_waiters > 0)
+					_condition.broadcast();
+				return;
+			}
+		}
+
+		// Let the pool's other tasks run before the next batch; keep going
+		// here if it has no worker left
+		if (count == _batchSize && _pool.submit(&_runner, _op))
+		{
+			t_currentStrand = previousStrand;
+			return;
+		}
+	}
+}
+
+void Strand::wait()
+{
+	assert(!isCurrent());
+
+	ScopedLock<Mutex> slock(_mutex);
+	++_waiters;
+	while (_count.load(std::memory_order_acquire) != 0)
+	{
+		if (_lost.load(std::memory_order_relaxed))
+		{
+			ReverseScopedLock<Mutex> sunlock(_mutex);
+			takeOverLost();
+		}
+		else
+			_condition.wait(&_mutex);
+	}
+	--_waiters;
+}
+
+bool Strand::isCurrent() const
+{
+	return t_currentStrand == this;
+}
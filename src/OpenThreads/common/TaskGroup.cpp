@@ -0,0 +1,216 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/TaskGroup>
+#include <OpenThreads/ScopedLock>
+#include <assert.h>
+#include <deque>
+using namespace OpenThreads;
+
+
+namespace {
+
+class FunctionTask : public PooledTask
+{
+public:
+	FunctionTask(const std::function<void(TaskContext&)>& function) : _function(function) {}
+
+	virtual void execute(TaskContext& ctxt) { _function(ctxt); }
+
+private:
+	std::function<void(TaskContext&)> _function;
+};
+
+}
+
+struct TaskGroup::State
+{
+	State() : running(0), waiters(0) {}
+
+	struct Entry
+	{
+		Task* task;
+		bool owned;
+		// The task was given the group's token, to be taken back
+		bool tokenGiven;
+	};
+
+	static void finish(const Entry& entry)
+	{
+		if (entry.owned)
+			delete entry.task;
+		else if (entry.tokenGiven)
+			entry.task->setCancellationToken(nullptr);
+	}
+
+	Mutex mutex;
+	Condition condition;
+	std::deque<Entry, TaskAllocator::Allocator<Entry> > pending;
+	// Tasks taken from pending that have not returned yet
+	unsigned int running;
+	// Threads blocked in wait()
+	unsigned int waiters;
+};
+
+// Handed to the pool for every task added to the group: runs the next
+// pending task, if the waiting thread has not already taken it.
+class TaskGroup::Runner : public PooledTask
+{
+public:
+	Runner(const std::shared_ptr<State>& state) : _state(state) {}
+
+	virtual void execute(TaskContext& ctxt)
+	{
+		runOne(*_state, ctxt);
+		delete this;
+	}
+
+	// The pending task is left to wait()
+	virtual void discard()
+	{
+		delete this;
+	}
+
+private:
+	std::shared_ptr<State> _state;
+};
+
+
+TaskGroup::TaskGroup(ThreadPool& pool, ThreadPool::DispatchOp* op)
+	: _pool(pool), _op(op), _state(std::allocate_shared<State>(TaskAllocator::Allocator<State>()))
+{
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool, CancellationToken& parent, ThreadPool::DispatchOp* op)
+	: _pool(pool), _op(op), _token(parent), _state(std::allocate_shared<State>(TaskAllocator::Allocator<State>()))
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	wait();
+}
+
+void TaskGroup::run(Task* task)
+{
+	assert(task);
+	push(task, false);
+}
+
+void TaskGroup::run(const std::function<void(TaskContext&)>& function)
+{
+	push(new FunctionTask(function), true);
+}
+
+void TaskGroup::push(Task* task, bool owned)
+{
+	bool tokenGiven = task->getCancellationToken() == nullptr;
+	if (tokenGiven)
+		task->setCancellationToken(&_token);
+	State::Entry entry = { task, owned, tokenGiven };
+
+	{
+		ScopedLock<Mutex> slock(_state->mutex);
+		if (_token.isCancelled())
+		{
+			State::finish(entry);
+			return;
+		}
+		_state->pending.push_back(entry);
+		if (_state->waiters > 0)
+			_state->condition.broadcast();
+	}
+
+	// Without a worker to take it, the task is run by wait()
+	Runner* runner = new Runner(_state);
+	if (!_pool.submit(runner, _op))
+		delete runner;
+}
+
+bool TaskGroup::runOne(State& state, TaskContext& ctxt)
+{
+	State::Entry entry;
+	{
+		ScopedLock<Mutex> slock(state.mutex);
+		if (state.pending.empty())
+			return false;
+		entry = state.pending.front();
+		state.pending.pop_front();
+		++state.running;
+	}
+
+	// Run the task in the caller's context, as the current task
+	Task* previousTask = ctxt._task;
+	TaskContext* previousContext = TaskContext::current();
+	ctxt._task = entry.task;
+	TaskContext::setCurrent(&ctxt);
+	entry.task->execute(ctxt);
+	TaskContext::setCurrent(previousContext);
+	ctxt._task = previousTask;
+
+	State::finish(entry);
+
+	ScopedLock<Mutex> slock(state.mutex);
+	if (--state.running == 0 && state.pending.empty() && state.waiters > 0)
+		state.condition.broadcast();
+	return true;
+}
+
+bool TaskGroup::wait()
+{
+	// Help from within the task being run, or as an outsider
+	TaskContext* current = TaskContext::current();
+	TaskContext outsider(&_pool, nullptr);
+	TaskContext& ctxt = current ? *current : outsider;
+
+	State& state = *_state;
+	for (;;)
+	{
+		while (runOne(state, ctxt))
+		{
+		}
+
+		ScopedLock<Mutex> slock(state.mutex);
+		while (state.pending.empty() && state.running > 0)
+		{
+			++state.waiters;
+			state.condition.wait(&state.mutex);
+			--state.waiters;
+		}
+		if (state.pending.empty())
+			break;
+	}
+	return !_token.isCancelled();
+}
+
+void TaskGroup::cancel()
+{
+	_token.cancel();
+
+	ScopedLock<Mutex> slock(_state->mutex);
+	for (size_t i = 0; i < _state->pending.size(); ++i)
+		State::finish(_state->pending[i]);
+	_state->pending.clear();
+	if (_state->running == 0 && _state->waiters > 0)
+		_state->condition.broadcast();
+}
+
+bool TaskGroup::isCancelled() const
+{
+	return _token.isCancelled();
+}
+
+CancellationToken& TaskGroup::getCancellationToken()
+{
+	return _token;
+}
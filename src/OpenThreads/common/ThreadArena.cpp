@@ -0,0 +1,259 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/ThreadArena>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define OT_ARENA_MMAP
+#endif
+
+using namespace OpenThreads;
+
+namespace {
+
+// Room left at the start of a chunk for its header.
+const size_t HEADER_SIZE = 64;
+
+const size_t MIN_CHUNK_SIZE = 4096;
+
+// Size of the huge pages chunks are rounded up to when the system does not
+// tell; the usual one on x86-64 and ARM64.
+const size_t DEFAULT_HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+enum ChunkKind
+{
+    HEAP_CHUNK,
+    MAPPED_CHUNK,
+    HUGE_PAGE_CHUNK
+};
+
+size_t getHugePageSize()
+{
+#if defined(_WIN32)
+    size_t size = GetLargePageMinimum();
+    return size > 0 ? size : DEFAULT_HUGE_PAGE_SIZE;
+#else
+    return DEFAULT_HUGE_PAGE_SIZE;
+#endif
+}
+
+// Map size bytes backed by huge pages, or return 0 if the system has none
+// to give; then map normal pages, asking for transparent huge pages where
+// the system has them.
+void* mapHugePages(size_t size, ChunkKind& kind)
+{
+#if defined(_WIN32)
+    // Needs the "Lock pages in memory" privilege
+    void* memory = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (memory)
+    {
+        kind = HUGE_PAGE_CHUNK;
+        return memory;
+    }
+    memory = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (memory)
+        kind = MAPPED_CHUNK;
+    return memory;
+#elif defined(OT_ARENA_MMAP)
+#ifdef MAP_HUGETLB
+    void* memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED)
+    {
+        kind = HUGE_PAGE_CHUNK;
+        return memory;
+    }
+#endif
+    void* mapped = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED)
+        return 0;
+#ifdef MADV_HUGEPAGE
+    madvise(mapped, size, MADV_HUGEPAGE);
+#endif
+    kind = MAPPED_CHUNK;
+    return mapped;
+#else
+    (void)size;
+    (void)kind;
+    return 0;
+#endif
+}
+
+void unmap(void* memory, size_t size)
+{
+#if defined(_WIN32)
+    (void)size;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#elif defined(OT_ARENA_MMAP)
+    munmap(memory, size);
+#else
+    (void)memory;
+    (void)size;
+#endif
+}
+
+}
+
+//-----------------------------------------------------------------------------
+// Chunks are linked in the order they are allocated from; the ones past the
+// current chunk are free.
+//
+struct ThreadArena::Chunk
+{
+    Chunk* next;
+    // Bytes taken from the system, header included
+    size_t size;
+    ChunkKind kind;
+
+    char* begin() { return reinterpret_cast<char*>(this) + HEADER_SIZE; }
+    char* end() { return reinterpret_cast<char*>(this) + size; }
+
+    static Chunk* create(size_t size, bool hugePages)
+    {
+        void* memory = 0;
+        ChunkKind kind = HEAP_CHUNK;
+        if (hugePages)
+        {
+            size_t pageSize = getHugePageSize();
+            size_t rounded = (size + pageSize - 1) / pageSize * pageSize;
+            memory = mapHugePages(rounded, kind);
+            if (memory)
+                size = rounded;
+        }
+        if (!memory)
+        {
+            memory = ::operator new(size);
+            kind = HEAP_CHUNK;
+        }
+
+        Chunk* chunk = static_cast<Chunk*>(memory);
+        chunk->next = 0;
+        chunk->size = size;
+        chunk->kind = kind;
+        return chunk;
+    }
+
+    static void destroy(Chunk* chunk)
+    {
+        if (chunk->kind == HEAP_CHUNK)
+            ::operator delete(chunk);
+        else
+            unmap(chunk, chunk->size);
+    }
+};
+
+ThreadArena::ThreadArena(size_t chunkSize, bool hugePages)
+    : _first(0), _current(0), _pos(0), _end(0), _chunkSize(DEFAULT_CHUNK_SIZE), _hugePages(hugePages)
+{
+    setChunkSize(chunkSize);
+}
+
+ThreadArena::~ThreadArena()
+{
+    reset();
+    trim();
+}
+
+ThreadArena& ThreadArena::current()
+{
+    static thread_local ThreadArena s_arena;
+    return s_arena;
+}
+
+void ThreadArena::setChunkSize(size_t chunkSize)
+{
+    _chunkSize = chunkSize < MIN_CHUNK_SIZE ? MIN_CHUNK_SIZE : chunkSize;
+}
+
+void* ThreadArena::allocateSlow(size_t size, size_t alignment)
+{
+    // Move on to the next free chunk if the allocation fits in it, else
+    // insert a new one before it
+    Chunk* next = _current ? _current->next : _first;
+    if (!next || size + alignment > (size_t)(next->end() - next->begin()))
+    {
+        size_t needed = HEADER_SIZE + size + alignment;
+        Chunk* chunk = Chunk::create(needed > _chunkSize ? needed : _chunkSize, _hugePages);
+        chunk->next = next;
+        if (_current)
+            _current->next = chunk;
+        else
+            _first = chunk;
+        next = chunk;
+    }
+    enter(next);
+    return allocate(size, alignment);
+}
+
+void ThreadArena::enter(Chunk* chunk)
+{
+    _current = chunk;
+    _pos = chunk->begin();
+    _end = chunk->end();
+}
+
+void ThreadArena::rewind(const Mark& m)
+{
+    if (!m.chunk)
+    {
+        reset();
+        return;
+    }
+    _current = m.chunk;
+    _pos = m.pos;
+    _end = m.chunk->end();
+}
+
+void ThreadArena::reset()
+{
+    // The first allocation enters the first chunk again
+    _current = 0;
+    _pos = 0;
+    _end = 0;
+}
+
+void ThreadArena::trim()
+{
+    Chunk* chunk = _current ? _current->next : _first;
+    if (_current)
+        _current->next = 0;
+    else
+        _first = 0;
+
+    while (chunk)
+    {
+        Chunk* next = chunk->next;
+        Chunk::destroy(chunk);
+        chunk = next;
+    }
+}
+
+bool ThreadArena::hasHugePages() const
+{
+    for (Chunk* chunk = _first; chunk; chunk = chunk->next)
+    {
+        if (chunk->kind == HUGE_PAGE_CHUNK)
+            return true;
+    }
+    return false;
+}
+
+size_t ThreadArena::getCapacity() const
+{
+    size_t capacity = 0;
+    for (Chunk* chunk = _first; chunk; chunk = chunk->next)
+        capacity += chunk->size - HEADER_SIZE;
+    return capacity;
+}
@@ -0,0 +1,119 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <OpenThreads/ThreadLocal>
+#include <OpenThreads/ScopedLock>
+#include "ThreadRecords.h"
+
+using namespace OpenThreads;
+
+//-----------------------------------------------------------------------------
+// A thread's value. Slots are kept until the ThreadLocal goes away and
+// reused by new threads once theirs has exited; value is only set or
+// cleared with _mutex held, and a slot without one is free.
+//
+struct ThreadLocalBase::Slot
+{
+    void* value;
+    Slot* next;
+};
+
+ThreadLocalBase::ThreadLocalBase(DestroyFunction destroy)
+    : _destroy(destroy), _slots(0)
+{
+    _serial = ThreadRecords::registerOwner(this);
+}
+
+ThreadLocalBase::~ThreadLocalBase()
+{
+    ThreadRecords::unregisterOwner(this);
+
+    // No exit callback runs from here on
+    Slot* slot = _slots;
+    while (slot)
+    {
+        Slot* next = slot->next;
+        if (slot->value)
+            _destroy(slot->value);
+        delete slot;
+        slot = next;
+    }
+}
+
+void* ThreadLocalBase::find() const
+{
+    Slot* slot = static_cast<Slot*>(ThreadRecords::find(this, _serial));
+    return slot ? slot->value : 0;
+}
+
+void ThreadLocalBase::attach(void* value)
+{
+    Slot* slot;
+    {
+        ScopedLock<Mutex> lock(_mutex);
+        for (slot = _slots; slot; slot = slot->next)
+        {
+            if (!slot->value)
+                break;
+        }
+        if (!slot)
+        {
+            slot = new Slot;
+            slot->next = _slots;
+            _slots = slot;
+        }
+        slot->value = value;
+    }
+
+    // Not under _mutex: the exit callback takes it with the registry locked
+    ThreadRecords::add(this, _serial, slot, &ThreadLocalBase::threadExited);
+}
+
+void ThreadLocalBase::threadExited(void* owner, void* slot)
+{
+    ThreadLocalBase* local = static_cast<ThreadLocalBase*>(owner);
+    Slot* s = static_cast<Slot*>(slot);
+
+    void* value;
+    {
+        ScopedLock<Mutex> lock(local->_mutex);
+        value = s->value;
+        s->value = 0;
+    }
+
+    // The value's destructor may use other ThreadLocals
+    if (value)
+        ThreadRecords::deferDestroy(value, local->_destroy);
+}
+
+void ThreadLocalBase::visit(VisitFunction visit, void* context) const
+{
+    ScopedLock<Mutex> lock(_mutex);
+    for (Slot* slot = _slots; slot; slot = slot->next)
+    {
+        if (slot->value)
+            visit(slot->value, context);
+    }
+}
+
+size_t ThreadLocalBase::size() const
+{
+    ScopedLock<Mutex> lock(_mutex);
+    size_t count = 0;
+    for (Slot* slot = _slots; slot; slot = slot->next)
+    {
+        if (slot->value)
+            ++count;
+    }
+    return count;
+}
@@ -15,35 +15,68 @@
 */
 
 #include <OpenThreads/ThreadPool>
+#include <OpenThreads/Backoff>
+#include <OpenThreads/Clock>
+#include <OpenThreads/ForkJoin>
 #include <OpenThreads/ScopedLock>
+#include "TimerWheel.h"
+#include "WorkStealingDeque.h"
 #include <algorithm>
 #include <assert.h>
 //#include <iostream>
 using namespace OpenThreads;
 
 
+namespace {
+
+thread_local TaskContext* t_currentContext = nullptr;
+
+}
+
 TaskContext::TaskContext()
-	: _pool(nullptr), _worker(nullptr)
+	: _pool(nullptr), _worker(nullptr), _task(nullptr)
 {
 }
 
 TaskContext::TaskContext(ThreadPool* pool, WorkerThread* worker)
-	: _pool(pool), _worker(worker)
+	: _pool(pool), _worker(worker), _task(nullptr)
 {
 	assert(pool);
-	assert(worker);
+}
+
+TaskContext* TaskContext::current()
+{
+	return t_currentContext;
+}
+
+void TaskContext::setCurrent(TaskContext* context)
+{
+	t_currentContext = context;
 }
 
 bool TaskContext::shouldStop(bool isSafeCancelPoint)
 {
-	assert(_worker);
-	bool ret = (_worker->_flags & WorkerThread::STOPPING) == WorkerThread::STOPPING;
-	if (ret && isSafeCancelPoint)
-		_worker->testCancel();
-	return ret;
+	(void)isSafeCancelPoint;
+	if (_worker && (_worker->_flags.load(std::memory_order_relaxed) & WorkerThread::STOPPING) == WorkerThread::STOPPING)
+		return true;
+	CancellationToken* token = _task ? _task->getCancellationToken() : nullptr;
+	return token && token->isCancelled();
+}
+
+CancellationToken& TaskContext::getCancellationToken()
+{
+	CancellationToken* token = _task ? _task->getCancellationToken() : nullptr;
+	assert(token || _worker);
+	return token ? *token : _worker->_stopToken;
+}
+
+ThreadArena& TaskContext::getArena()
+{
+	return _worker ? _worker->_arena : ThreadArena::current();
 }
 
 Task::Task()
+	: _token(nullptr), _affinityKey(0)
 {
 }
 
@@ -54,7 +87,8 @@ Task::~Task()
 
 
 WorkerThread::WorkerThread()
-	: Thread(), _pool(nullptr), _flags(0)
+	: Thread(), _pool(nullptr), _flags(0), _key(0), _spawned(new WorkStealingDeque), _idle(false),
+	_stealSeed((unsigned int)(size_t)this | 1), _fibers(0), _queueDepth(0)
 {
 
 }
@@ -92,7 +126,17 @@ void WorkerThread::run()
 		while (!shouldStop())
 		{
 			while (_tasks.empty())
-				_condition.wait(&_mutex);
+			{
+				if (_pool->_forkJoinUsed.load(std::memory_order_relaxed))
+				{
+					ReverseScopedLock<Mutex> sunlock(_mutex);
+					stealWhileIdle();
+				}
+				if (_tasks.empty())
+					_condition.wait(&_mutex);
+				if (_idle.exchange(false, std::memory_order_relaxed))
+					_pool->_idleWorkers.fetch_sub(1, std::memory_order_relaxed);
+			}
 
 			if (shouldStop())
 				break;
@@ -104,20 +148,30 @@ void WorkerThread::run()
 			}
 			else
 			{
-				Tasks copy = _tasks;
-				_tasks.clear();
+				Tasks copy;
+				copy.swap(_tasks);
 
 				{
 					ReverseScopedLock<Mutex> sunlock(_mutex);
 					for (Tasks::iterator it = copy.begin(); it != copy.end(); ++it)
 					{
 						if (*it != nullptr)
+						{
+							_context._task = *it;
+							TaskContext::setCurrent(&_context);
 							executeTask(*it);
+							TaskContext::setCurrent(nullptr);
+							_context._task = nullptr;
+							_queueDepth.fetch_sub(1, std::memory_order_relaxed);
+						}
 					}
 				}
 			}
 		}
 	}
+
+	// Stopped without finishing the tasks: hand back the ones left
+	discardTasks();
 }
 
 void WorkerThread::executeTask(Task* task)
@@ -125,9 +179,67 @@ void WorkerThread::executeTask(Task* task)
 	task->execute(_context);
 }
 
+bool WorkerThread::runStolen()
+{
+	ForkJoinFrame* frame = _pool->steal(this);
+	if (frame == nullptr)
+		return false;
+	runFrame(frame);
+	return true;
+}
+
+void WorkerThread::runFrame(ForkJoinFrame* frame)
+{
+	// As the task that spawned it, which may be cancelled
+	Task* previousTask = _context._task;
+	TaskContext* previousContext = TaskContext::current();
+	_context._task = frame->_task;
+	TaskContext::setCurrent(&_context);
+	frame->invoke();
+	TaskContext::setCurrent(previousContext);
+	_context._task = previousTask;
+
+	// The spawner may return, destroying the frame, as soon as this is seen
+	frame->_done.store(true, std::memory_order_release);
+}
+
+void WorkerThread::stealWhileIdle()
+{
+	// Spin for a while before going to sleep: in a recursion, frames are
+	// spawned again soon after the deques have been emptied.
+	const unsigned int ATTEMPTS = 32;
+	for (;;)
+	{
+		Backoff backoff;
+		for (unsigned int attempt = 0; attempt < ATTEMPTS; ++attempt)
+		{
+			if (runStolen())
+			{
+				attempt = 0;
+				backoff.reset();
+			}
+			else
+				backoff.pause();
+		}
+
+		// Announce the worker idle, then look once more: a frame spawned
+		// meanwhile is either seen here or its spawner sees the worker idle.
+		_idle.store(true, std::memory_order_relaxed);
+		_pool->_idleWorkers.fetch_add(1, std::memory_order_seq_cst);
+		ForkJoinFrame* frame = _pool->steal(this);
+		if (frame == nullptr)
+			return;
+		if (_idle.exchange(false, std::memory_order_relaxed))
+			_pool->_idleWorkers.fetch_sub(1, std::memory_order_relaxed);
+		runFrame(frame);
+	}
+}
+
 void WorkerThread::queue(Task* task)
 {
 	ScopedLock<Mutex> slock(_mutex);
+	if (task)
+		_queueDepth.fetch_add(1, std::memory_order_relaxed);
 	_tasks.push_back(task);
 	//std::cout << "queued " << _tasks.size() << "th task" << std::endl;
 	_condition.signal();
@@ -136,19 +248,23 @@ void WorkerThread::queue(Task* task)
 void WorkerThread::stop(bool finishTasks)
 {
 	ScopedLock<Mutex> slock(_mutex);
-	_flags |= STOPPING | (finishTasks ? STOP_AFTER_TASKS : 0);
+	_flags.fetch_or(STOPPING | (finishTasks ? STOP_AFTER_TASKS : 0), std::memory_order_relaxed);
 	_tasks.push_back(nullptr);
 	_condition.signal();
+	if (!finishTasks)
+		_stopToken.cancel();
 }
 
 bool WorkerThread::shouldStop()
 {
-	if ((_flags & STOPPING) == STOPPING)
+	unsigned int flags = _flags.load(std::memory_order_relaxed);
+	if ((flags & STOPPING) == STOPPING)
 	{
-		if ((_flags & STOP_AFTER_TASKS) == STOP_AFTER_TASKS)
+		if ((flags & STOP_AFTER_TASKS) == STOP_AFTER_TASKS)
 		{
-			// Stop when queue is empty
-			if (_tasks.empty())
+			// Stop when queue is empty and no suspended fiber is left to
+			// finish
+			if (_tasks.empty() && _fibers == 0)
 				return true;
 		}
 		else
@@ -167,16 +283,94 @@ bool WorkerThread::shouldStop()
 
 
 
+// Runs stop() for stopAsync()
+class ThreadPool::StopHandle::State : public Thread
+{
+public:
+	State(ThreadPool* pool, bool finishAllTasks, unsigned int politeTimeout, unsigned int aggressiveTimeout, bool fatality)
+		: _pool(pool), _finishAllTasks(finishAllTasks), _politeTimeout(politeTimeout), _aggressiveTimeout(aggressiveTimeout),
+		_fatality(fatality), _done(false), _result(-1) {}
+
+	virtual void run()
+	{
+		int result = _pool->stop(_finishAllTasks, _politeTimeout, _aggressiveTimeout, _fatality);
+
+		ScopedLock<Mutex> slock(_mutex);
+		_result = result;
+		_done = true;
+		_condition.broadcast();
+	}
+
+	bool isDone()
+	{
+		ScopedLock<Mutex> slock(_mutex);
+		return _done;
+	}
+
+	int wait(unsigned long long deadline)
+	{
+		ScopedLock<Mutex> slock(_mutex);
+		while (!_done)
+		{
+			if (deadline == 0)
+				_condition.wait(&_mutex);
+			else
+			{
+				unsigned long long now = Clock::milliseconds();
+				if (now >= deadline)
+					return -1;
+				_condition.wait(&_mutex, (unsigned long)(deadline - now));
+			}
+		}
+		return _result;
+	}
+
+private:
+	ThreadPool* _pool;
+	bool _finishAllTasks;
+	unsigned int _politeTimeout;
+	unsigned int _aggressiveTimeout;
+	bool _fatality;
+
+	Mutex _mutex;
+	Condition _condition;
+	bool _done;
+	int _result;
+};
+
 ThreadPool::ThreadPool(DispatchOp* defaultDispatch)
-	: _stopping(false), _defaultDispatch(defaultDispatch)
+	: _stopping(false), _defaultDispatch(defaultDispatch), _nextKey(0), _workersEnded(0),
+	_snapshot(nullptr), _forkJoinUsed(false), _idleWorkers(0)
 {
 	if (!_defaultDispatch)
 		_defaultDispatch = std::unique_ptr<DispatchOp>(new DispatchDummy);
+	publishSnapshot();
 }
 
 ThreadPool::~ThreadPool()
 {
+	if (_asyncStop)
+		_asyncStop->join();
+	if (_timers)
+		_timers->shutdown();
+	delete _snapshot.load(std::memory_order_relaxed);
+}
 
+void WorkerThread::discardTasks()
+{
+	Tasks dropped;
+	{
+		ScopedLock<Mutex> slock(_mutex);
+		dropped.swap(_tasks);
+	}
+	for (Tasks::iterator it = dropped.begin(); it != dropped.end(); ++it)
+	{
+		if (*it != nullptr)
+		{
+			(*it)->discard();
+			_queueDepth.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
 }
 
 int ThreadPool::add(WorkerThread* worker)
@@ -185,39 +379,53 @@ int ThreadPool::add(WorkerThread* worker)
 	if (worker->isRunning())
 		return 0;
 
+	// Keys are handed out by the pool rather than taken from the thread id,
+	// which is only known once the thread runs and may be 0.
+	int key;
 	{
 		ScopedLock<Mutex> slock(_mutex);
 		if (_stopping)
 			return 0;
+		key = ++_nextKey;
+		_workers[key] = worker;
+		publishSnapshot();
 	}
 
+	worker->_key = key;
 	worker->setPool(this);
-	worker->start();
-
-	int key = worker->getThreadId();
-	_workers[key] = worker;
+	if (worker->start() != 0)
+	{
+		{
+			ScopedLock<Mutex> slock(_mutex);
+			_workers.erase(key);
+			publishSnapshot();
+		}
+		// Tasks were queued to the worker meanwhile: once the submits that
+		// found it in the snapshot are done, hand them back
+		_snapshotEpochs.synchronize();
+		worker->discardTasks();
+		return 0;
+	}
 	return key;
 }
 
-void ThreadPool::waitForTermination(Workers& workers, unsigned int timeout)
+ThreadPool::Workers ThreadPool::waitForTermination(unsigned int timeout)
 {
-	unsigned int startWait = Thread::getTickCount();
-	while (!workers.empty() && (Thread::getTickCount() - startWait) < timeout)
+	_workersEnded.block(timeout);
+
+	ScopedLock<Mutex> slock(_mutex);
+	// A thread terminated without unwinding its stack never reports its end
+	for (Workers::iterator it = _stoppingWorkers.begin(); it != _stoppingWorkers.end();)
 	{
-		bool idledThisLoop = true;
-		for (Workers::iterator it = workers.begin(); it != workers.end(); ++it)
+		if (!it->second->isRunning())
 		{
-			if (!it->second->isRunning())
-			{
-				workers.erase(it);
-				idledThisLoop = false;
-				break;
-			}
+			_stoppingWorkers.erase(it++);
+			_workersEnded.completed();
 		}
-
-		if (idledThisLoop)
-			Thread::microSleep(50000);
+		else
+			++it;
 	}
+	return _stoppingWorkers;
 }
 
 int ThreadPool::stop(bool finishAllTasks, unsigned int politeTimeout, unsigned int overallTimeout, bool fatality)
@@ -225,14 +433,33 @@ int ThreadPool::stop(bool finishAllTasks, unsigned int politeTimeout, unsigned i
 	if (overallTimeout < politeTimeout)
 		overallTimeout = politeTimeout;
 
+	ScopedLock<Mutex> stopLock(_stopMutex);
+
 	Workers all, alive;
+	TimerWheel* timers;
 	{
 		ScopedLock<Mutex> slock(_mutex);
 		_stopping = true;
-		alive.swap(_workers);
-		all = alive;
+		_stoppingWorkers.swap(_workers);
+		_workers.clear();
+		publishSnapshot();
+		all = alive = _stoppingWorkers;
+		_workersEnded.setBlockCount((unsigned int)_stoppingWorkers.size());
+		_workersEnded.reset();
+		timers = _timers.get();
 	}
 
+	// Submits that found the workers in the previous snapshot queue their
+	// task before the workers are asked to stop; later ones find none.
+	_snapshotEpochs.synchronize();
+
+	// Pending timers are dropped, and are not started again even if the
+	// workers are given back below. When the tasks are finished, the timers
+	// that wake up sleeping fibers must still fire, so the wheel runs until
+	// the workers have drained; the others find no worker to submit to.
+	if (timers && !finishAllTasks)
+		timers->shutdown();
+
 #define GOTO_END(m) { method = m; break; }
 
 	int method = -1;
@@ -248,7 +475,7 @@ int ThreadPool::stop(bool finishAllTasks, unsigned int politeTimeout, unsigned i
 				//std::cout << "asking " << it->first << " to stop" << std::endl;
 				it->second->stop(finishAllTasks);
 			}
-			waitForTermination(alive, politeTimeout);
+			alive = waitForTermination(politeTimeout);
 		}
 
 		if (alive.empty())
@@ -257,13 +484,19 @@ int ThreadPool::stop(bool finishAllTasks, unsigned int politeTimeout, unsigned i
 		unsigned int aggressiveTimeout = overallTimeout - politeTimeout;
 		if (aggressiveTimeout > 0)
 		{
+			// Cooperative cancellation first, then thread cancellation for
+			// the tasks that ignore it
+			for (Workers::iterator it = alive.begin(); it != alive.end(); ++it)
+				it->second->_stopToken.cancel();
+			alive = waitForTermination(aggressiveTimeout / 2);
+
 			for (Workers::iterator it = alive.begin(); it != alive.end(); ++it)
 			{
 				//std::cout << "cancelling " << it->first << std::endl;
 				it->second->cancel();
 			}
-
-			waitForTermination(alive, aggressiveTimeout);
+			if (!alive.empty())
+				alive = waitForTermination(aggressiveTimeout - aggressiveTimeout / 2);
 		}
 
 		if (alive.empty())
@@ -291,16 +524,21 @@ int ThreadPool::stop(bool finishAllTasks, unsigned int politeTimeout, unsigned i
 	}
 	assert(method >= 0);
 
+	if (timers)
+		timers->shutdown();
+
 	// Join all threads (except those that we could not kill anyway)
 	for (Workers::iterator it = all.begin(); it != all.end(); ++it)
 		it->second->join();
 
+	ScopedLock<Mutex> slock(_mutex);
 	if (method == 0)
 	{
-		ScopedLock<Mutex> slock(_mutex);
 		_stopping = false;
-		_workers = alive;
+		_workers = _stoppingWorkers;
 	}
+	_stoppingWorkers.clear();
+	publishSnapshot();
 
 	return method;
 }
@@ -309,54 +547,322 @@ void ThreadPool::workerEnded(WorkerThread* worker)
 {
 	ScopedLock<Mutex> slock(_mutex);
 
-	int key = worker->getThreadId();
+	int key = worker->_key;
 	assert(key > 0);
 
 	Workers::iterator it = _workers.find(key);
 	assert(it == _workers.end() || it->second == worker);
 	if (it != _workers.end())
+	{
 		_workers.erase(it);
+		publishSnapshot();
+	}
+	else
+	{
+		// Being stopped: count it down, which wakes stop() up with the last one
+		it = _stoppingWorkers.find(key);
+		if (it != _stoppingWorkers.end())
+		{
+			_stoppingWorkers.erase(it);
+			_workersEnded.completed();
+		}
+	}
 	//std::cout << "Worker " << key << " ended.";
 }
 
-void ThreadPool::submit(Task* task, DispatchOp* op)
+bool ThreadPool::StopHandle::isDone() const
+{
+	return _state ? _state->isDone() : true;
+}
+
+int ThreadPool::StopHandle::wait() const
+{
+	return _state ? _state->wait(0) : -1;
+}
+
+int ThreadPool::StopHandle::wait(unsigned long timeout) const
+{
+	return _state ? _state->wait(Clock::milliseconds() + timeout) : -1;
+}
+
+ThreadPool::StopHandle ThreadPool::stopAsync(bool finishAllTasks, unsigned int politeTimeout, unsigned int aggressiveTimeout, bool fatality)
 {
 	ScopedLock<Mutex> slock(_mutex);
-	if (op == nullptr) _defaultDispatch->dispatch(_workers, task);
-	else op->dispatch(_workers, task);
+	if (_asyncStop)
+	{
+		if (!_asyncStop->isDone())
+			return StopHandle(_asyncStop);
+		_asyncStop->join();
+	}
+
+	_asyncStop = std::make_shared<StopHandle::State>(this, finishAllTasks, politeTimeout, aggressiveTimeout, fatality);
+	_asyncStop->start();
+	return StopHandle(_asyncStop);
 }
 
-ThreadPool::DispatchRoundRobin::DispatchRoundRobin()
-	: _lastSize(0), _lastHash(0)
+void ThreadPool::publishSnapshot()
 {
+	WorkerSnapshot* snapshot = new WorkerSnapshot;
+	snapshot->reserve(_workers.size());
+	for (Workers::const_iterator it = _workers.begin(); it != _workers.end(); ++it)
+		snapshot->push_back(it->second);
+	const WorkerSnapshot* previous = _snapshot.exchange(snapshot, std::memory_order_seq_cst);
+	if (previous)
+		_snapshotEpochs.retire(const_cast<WorkerSnapshot*>(previous));
 }
 
-bool ThreadPool::DispatchRoundRobin::dispatch(const Workers& workers, Task* task)
+ForkJoinFrame* ThreadPool::steal(WorkerThread* thief)
 {
-	update(workers);
-	if (_it == workers.end())
-		return false;
+	EpochGuard guard(_snapshotEpochs);
+	const WorkerSnapshot& workers = *_snapshot.load(std::memory_order_acquire);
+	size_t count = workers.size();
+	if (count < 2)
+		return nullptr;
+
+	// Start from a random worker, so that thieves spread over the victims
+	unsigned int x = thief->_stealSeed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	thief->_stealSeed = x;
+
+	size_t start = x % count;
+	for (size_t i = 0; i < count; ++i)
+	{
+		WorkerThread* victim = workers[(start + i) % count];
+		if (victim == thief || victim->_spawned->looksEmpty())
+			continue;
+		ForkJoinFrame* frame = victim->_spawned->steal();
+		if (frame)
+			return frame;
+	}
+	return nullptr;
+}
 
-	_it->second->queue(task);
-	++_it;
-	return true;
+void ThreadPool::wakeIdleWorker()
+{
+	EpochGuard guard(_snapshotEpochs);
+	const WorkerSnapshot& workers = *_snapshot.load(std::memory_order_acquire);
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		WorkerThread* worker = workers[i];
+		if (worker->_idle.load(std::memory_order_relaxed) && worker->_idle.exchange(false, std::memory_order_relaxed))
+		{
+			_idleWorkers.fetch_sub(1, std::memory_order_relaxed);
+			// A null task only wakes the worker up
+			worker->queue(nullptr);
+			return;
+		}
+	}
 }
 
-unsigned int ThreadPool::DispatchRoundRobin::hash(const Workers& workers)
+void ThreadPool::enableStealing()
 {
-	unsigned int sum = 0;
+	if (_forkJoinUsed.exchange(true))
+		return;
+
+	// Workers asleep since before do not know about stealing yet
+	EpochGuard guard(_snapshotEpochs);
+	const WorkerSnapshot& workers = *_snapshot.load(std::memory_order_acquire);
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i]->queue(nullptr);
+}
+
+bool ThreadPool::submit(Task* task, DispatchOp* op)
+{
+	if (op == nullptr)
+		op = _defaultDispatch.get();
+	if (op->isLockFree())
+	{
+		EpochGuard guard(_snapshotEpochs);
+		return static_cast<LockFreeDispatchOp*>(op)->dispatch(*_snapshot.load(std::memory_order_acquire), task);
+	}
+
+	ScopedLock<Mutex> slock(_mutex);
+	return op->dispatch(_workers, task);
+}
+
+ThreadPool::TimerId ThreadPool::schedule(Task* task, unsigned long long delayUs, DispatchOp* op)
+{
+	TimerWheel* timers = getTimers();
+	return timers ? timers->add(task, op, delayUs, 0) : 0;
+}
+
+ThreadPool::TimerId ThreadPool::scheduleRepeating(Task* task, unsigned long long periodUs, DispatchOp* op)
+{
+	TimerWheel* timers = getTimers();
+	return timers ? timers->add(task, op, periodUs, periodUs > 0 ? periodUs : 1) : 0;
+}
+
+bool ThreadPool::cancel(TimerId id)
+{
+	TimerWheel* timers;
+	{
+		ScopedLock<Mutex> slock(_mutex);
+		timers = _timers.get();
+	}
+	return timers ? timers->cancel(id) : false;
+}
+
+void ThreadPool::resetArenas()
+{
+	ScopedLock<Mutex> slock(_mutex);
+	for (Workers::iterator it = _workers.begin(); it != _workers.end(); ++it)
+		it->second->_arena.reset();
+}
+
+TimerWheel* ThreadPool::getTimers()
+{
+	{
+		ScopedLock<Mutex> slock(_mutex);
+		if (_stopping)
+			return nullptr;
+		if (_timers)
+			return _timers.get();
+	}
+
+	// Started without the lock held: start() waits for the thread, which
+	// suspends a Fiber, and the worker may then run tasks taking the lock.
+	std::unique_ptr<TimerWheel> timers(new TimerWheel(this));
+	timers->start();
+
+	TimerWheel* current = nullptr;
+	{
+		ScopedLock<Mutex> slock(_mutex);
+		if (!_stopping && !_timers)
+			_timers = std::move(timers);
+		if (!_stopping)
+			current = _timers.get();
+	}
+	// Another thread created the wheel first, or the pool is being stopped
+	if (timers)
+		timers->shutdown();
+	return current;
+}
+
+bool ThreadPool::LockFreeDispatchOp::dispatch(const Workers& workers, Task* task)
+{
+	WorkerSnapshot snapshot;
+	snapshot.reserve(workers.size());
 	for (Workers::const_iterator it = workers.begin(); it != workers.end(); ++it)
-		sum ^= (unsigned int)it->first;
-	return sum;
+		snapshot.push_back(it->second);
+	return dispatch(snapshot, task);
+}
+
+bool ThreadPool::LockFreeDispatchOp::dispatch(const WorkerSnapshot& workers, Task* task)
+{
+	WorkerThread* worker = select(workers, task);
+	if (worker == nullptr)
+		return false;
+	worker->queue(task);
+	return true;
+}
+
+ThreadPool::DispatchRoundRobin::DispatchRoundRobin()
+	: _next(0)
+{
+}
+
+WorkerThread* ThreadPool::DispatchRoundRobin::select(const WorkerSnapshot& workers, Task*)
+{
+	if (workers.empty())
+		return nullptr;
+	return workers[_next.fetch_add(1, std::memory_order_relaxed) % workers.size()];
+}
+
+ThreadPool::DispatchLeastLoaded::DispatchLeastLoaded(unsigned int maxScan)
+	: _maxScan(maxScan > 0 ? maxScan : 1), _next(0)
+{
 }
 
-void ThreadPool::DispatchRoundRobin::update(const Workers& workers)
+WorkerThread* ThreadPool::DispatchLeastLoaded::select(const WorkerSnapshot& workers, Task*)
 {
-	unsigned int curHash = hash(workers);
-	if (_lastSize == 0 || _lastSize != workers.size() || _lastHash == 0 || _lastHash != curHash || _it == workers.end())
+	size_t count = workers.size();
+	if (count == 0)
+		return nullptr;
+
+	size_t start = _next.fetch_add(1, std::memory_order_relaxed) % count;
+	size_t scan = count < _maxScan ? count : _maxScan;
+	WorkerThread* best = nullptr;
+	unsigned int bestDepth = 0;
+	for (size_t i = 0; i < scan; ++i)
 	{
-		_lastHash = curHash;
-		_lastSize = workers.size();
-		_it = workers.begin();
+		WorkerThread* worker = workers[(start + i) % count];
+		unsigned int depth = worker->getQueueDepth();
+		if (best == nullptr || depth < bestDepth)
+		{
+			best = worker;
+			bestDepth = depth;
+			if (depth == 0)
+				break;
+		}
 	}
+	return best;
+}
+
+namespace {
+
+// State of the random choices of DispatchPowerOfTwoChoices, one per
+// submitting thread so that they share no cache line
+thread_local unsigned int t_dispatchSeed = 0;
+
+unsigned int nextRandom()
+{
+	unsigned int x = t_dispatchSeed;
+	if (x == 0)
+		x = (unsigned int)(size_t)&t_dispatchSeed | 1;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	t_dispatchSeed = x;
+	return x;
+}
+
+// Lamping and Veach's jump consistent hash: the bucket of key among
+// buckets, which only changes for the keys moving to a new last bucket
+// when one is added.
+size_t jumpHash(unsigned long long key, size_t buckets)
+{
+	long long b = -1, j = 0;
+	while (j < (long long)buckets)
+	{
+		b = j;
+		key = key * 2862933555777941757ULL + 1;
+		j = (long long)((b + 1) * ((double)(1LL << 31) / (double)((key >> 33) + 1)));
+	}
+	return (size_t)b;
+}
+
+}
+
+WorkerThread* ThreadPool::DispatchPowerOfTwoChoices::select(const WorkerSnapshot& workers, Task*)
+{
+	size_t count = workers.size();
+	if (count < 2)
+		return count == 1 ? workers[0] : nullptr;
+
+	unsigned int x = nextRandom();
+	size_t first = x % count;
+	// Another worker than the first one
+	size_t second = (first + 1 + (x >> 16) % (count - 1)) % count;
+	WorkerThread* a = workers[first];
+	WorkerThread* b = workers[second];
+	return b->getQueueDepth() < a->getQueueDepth() ? b : a;
+}
+
+ThreadPool::DispatchKeyAffinity::DispatchKeyAffinity()
+	: _next(0)
+{
+}
+
+WorkerThread* ThreadPool::DispatchKeyAffinity::select(const WorkerSnapshot& workers, Task* task)
+{
+	size_t count = workers.size();
+	if (count == 0)
+		return nullptr;
+
+	unsigned long long key = task->getAffinityKey();
+	if (key == 0)
+		return workers[_next.fetch_add(1, std::memory_order_relaxed) % count];
+	return workers[jumpHash(key, count)];
 }
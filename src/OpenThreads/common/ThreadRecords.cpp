@@ -0,0 +1,163 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include "ThreadRecords.h"
+
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <map>
+#include <stddef.h>
+#include <vector>
+
+using namespace OpenThreads;
+
+namespace {
+
+struct Entry
+{
+    const void* owner;
+    unsigned long long serial;
+    void* record;
+    ThreadRecords::ExitCallback callback;
+};
+
+Mutex& registryMutex()
+{
+    static Mutex s_mutex;
+    return s_mutex;
+}
+
+// Live owners and their serial numbers; guarded by registryMutex().
+typedef std::map<const void*, unsigned long long> Owners;
+
+Owners& liveOwners()
+{
+    static Owners s_owners;
+    return s_owners;
+}
+
+unsigned long long s_nextSerial = 1;
+
+bool isAlive(const Entry& e)
+{
+    Owners::const_iterator it = liveOwners().find(e.owner);
+    return it != liveOwners().end() && it->second == e.serial;
+}
+
+// Last hit, kept in a trivially destructible variable for the fast path.
+thread_local Entry t_last = { 0, 0, 0, 0 };
+
+struct Deferred
+{
+    void* object;
+    void (*destroy)(void*);
+};
+
+// The entries of one thread. Destroyed, and the owners called back, when
+// the thread exits.
+struct ThreadEntries
+{
+    ~ThreadEntries()
+    {
+        // Deferred destructors may add records again, which need another
+        // pass, as destructors of pthread keys do
+        for (int pass = 0; pass < MAX_EXIT_PASSES && !entries.empty(); ++pass)
+        {
+            {
+                ScopedLock<Mutex> lock(registryMutex());
+                std::vector<Entry> exited;
+                exited.swap(entries);
+                for (size_t i = 0; i < exited.size(); ++i)
+                {
+                    if (isAlive(exited[i]))
+                        exited[i].callback(const_cast<void*>(exited[i].owner), exited[i].record);
+                }
+                // The records may now be another thread's
+                Entry none = { 0, 0, 0, 0 };
+                t_last = none;
+            }
+
+            std::vector<Deferred> objects;
+            objects.swap(deferred);
+            for (size_t i = 0; i < objects.size(); ++i)
+                objects[i].destroy(objects[i].object);
+        }
+    }
+
+    static const int MAX_EXIT_PASSES = 4;
+
+    std::vector<Entry> entries;
+    std::vector<Deferred> deferred;
+};
+
+thread_local ThreadEntries t_entries;
+
+}
+
+unsigned long long ThreadRecords::registerOwner(void* owner)
+{
+    ScopedLock<Mutex> lock(registryMutex());
+    unsigned long long serial = s_nextSerial++;
+    liveOwners()[owner] = serial;
+    return serial;
+}
+
+void ThreadRecords::unregisterOwner(void* owner)
+{
+    ScopedLock<Mutex> lock(registryMutex());
+    liveOwners().erase(owner);
+}
+
+void* ThreadRecords::find(const void* owner, unsigned long long serial)
+{
+    if (t_last.owner == owner && t_last.serial == serial)
+        return t_last.record;
+
+    std::vector<Entry>& entries = t_entries.entries;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i].owner == owner && entries[i].serial == serial)
+        {
+            t_last = entries[i];
+            return entries[i].record;
+        }
+    }
+    return 0;
+}
+
+void ThreadRecords::add(void* owner, unsigned long long serial, void* record, ExitCallback callback)
+{
+    Entry e = { owner, serial, record, callback };
+
+    ScopedLock<Mutex> lock(registryMutex());
+
+    // Drop the entries of owners that have gone away meanwhile.
+    std::vector<Entry>& entries = t_entries.entries;
+    for (size_t i = 0; i < entries.size(); )
+    {
+        if (isAlive(entries[i]))
+            ++i;
+        else
+            entries.erase(entries.begin() + i);
+    }
+
+    entries.push_back(e);
+    t_last = e;
+}
+
+void ThreadRecords::deferDestroy(void* object, void (*destroy)(void*))
+{
+    Deferred d = { object, destroy };
+    t_entries.deferred.push_back(d);
+}
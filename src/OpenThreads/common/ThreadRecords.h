@@ -0,0 +1,60 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+//
+// ThreadRecords.h - private header for per-thread, per-object records
+// ~~~~~~~~~~~~~~~
+//
+
+#ifndef _THREADRECORDS_H_
+#define _THREADRECORDS_H_
+
+namespace OpenThreads {
+
+//-----------------------------------------------------------------------------
+// Lets an object (an "owner", such as an EpochDomain) attach a record to
+// every thread that uses it, and find it again cheaply. When a thread exits,
+// the owner is called back for each of its records that is still alive, so
+// that it can recycle the record. Owners can be destroyed while threads
+// still reference them: each registration gets a serial number, and
+// records of a dead owner are ignored even if a new owner reuses its
+// address.
+//
+class ThreadRecords
+{
+public:
+    typedef void (*ExitCallback)(void* owner, void* record);
+
+    // Mark owner alive; returns its serial number.
+    static unsigned long long registerOwner(void* owner);
+
+    // Mark owner dead. Once this returns, no exit callback for it is
+    // running or will run.
+    static void unregisterOwner(void* owner);
+
+    // Return the calling thread's record for owner, or 0.
+    static void* find(const void* owner, unsigned long long serial);
+
+    // Attach record to the calling thread; callback is invoked, with the
+    // registry lock held, when the thread exits.
+    static void add(void* owner, unsigned long long serial, void* record, ExitCallback callback);
+
+    // From an exit callback only: call destroy(object) once the callbacks
+    // have run and the registry lock is released, for objects whose
+    // destructors may themselves use records.
+    static void deferDestroy(void* object, void (*destroy)(void*));
+};
+
+}
+
+#endif // _THREADRECORDS_H_
@@ -0,0 +1,305 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include "TimerWheel.h"
+#include <OpenThreads/Clock>
+#include <OpenThreads/ScopedLock>
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+using namespace OpenThreads;
+
+
+namespace {
+
+const unsigned long long TICK_US = ThreadPool::TIMER_RESOLUTION;
+const unsigned long long NEVER = ~0ULL;
+
+// Below this, the thread sleeps instead of waiting on its condition, whose
+// timeout is in milliseconds.
+const unsigned long long MIN_CONDITION_WAIT_US = 2000;
+
+}
+
+
+TimerWheel::TimerWheel(ThreadPool* pool)
+	: _pool(pool), _running(true), _wakeTick(NEVER), _nextId(0)
+{
+	memset(_slots, 0, sizeof(_slots));
+	_currentTick = now() / TICK_US;
+}
+
+TimerWheel::~TimerWheel()
+{
+	shutdown();
+	for (size_t i = 0; i < _free.size(); ++i)
+		delete _free[i];
+}
+
+unsigned long long TimerWheel::now() const
+{
+	return Clock::microseconds();
+}
+
+unsigned long long TimerWheel::toTicks(unsigned long long us) const
+{
+	return (us + TICK_US - 1) / TICK_US;
+}
+
+TimerWheel::TimerId TimerWheel::add(Task* task, ThreadPool::DispatchOp* op, unsigned long long delayUs, unsigned long long periodUs)
+{
+	assert(task);
+	unsigned long long deadline = toTicks(now() + delayUs);
+
+	ScopedLock<Mutex> slock(_mutex);
+	if (!_running)
+		return 0;
+
+	Timer* timer = allocate();
+	timer->id = ++_nextId;
+	timer->task = task;
+	timer->op = op;
+	timer->period = periodUs > 0 ? toTicks(periodUs) : 0;
+	// The thread may lag behind the clock; a timer is never placed in a slot
+	// it has already passed.
+	timer->deadline = deadline > _currentTick ? deadline : _currentTick + 1;
+	insert(timer);
+	_timers[timer->id] = timer;
+
+	if (timer->deadline < _wakeTick)
+		_condition.signal();
+	return timer->id;
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+	ScopedLock<Mutex> slock(_mutex);
+	std::unordered_map<TimerId, Timer*>::iterator it = _timers.find(id);
+	if (it == _timers.end())
+		return false;
+
+	unlink(it->second);
+	release(it->second);
+	_timers.erase(it);
+
+	// A repeating timer is re-armed before being submitted: let the run
+	// being submitted go first
+	if (Thread::CurrentThread() != this)
+	{
+		while (std::find(_firing.begin(), _firing.end(), id) != _firing.end())
+			_fired.wait(&_mutex);
+	}
+	return true;
+}
+
+void TimerWheel::shutdown()
+{
+	{
+		ScopedLock<Mutex> slock(_mutex);
+		if (!_running)
+			return;
+		_running = false;
+		_condition.signal();
+	}
+	join();
+
+	ScopedLock<Mutex> slock(_mutex);
+	for (std::unordered_map<TimerId, Timer*>::iterator it = _timers.begin(); it != _timers.end(); ++it)
+	{
+		unlink(it->second);
+		release(it->second);
+	}
+	_timers.clear();
+}
+
+size_t TimerWheel::getPendingCount()
+{
+	ScopedLock<Mutex> slock(_mutex);
+	return _timers.size();
+}
+
+void TimerWheel::run()
+{
+	std::vector<std::pair<Task*, ThreadPool::DispatchOp*> > due;
+
+	ScopedLock<Mutex> slock(_mutex);
+	while (_running)
+	{
+		advance(now() / TICK_US);
+
+		if (!_expired.empty())
+		{
+			// Re-arm the repeating timers before letting go of the lock, so
+			// that cancel() always finds them.
+			for (size_t i = 0; i < _expired.size(); ++i)
+			{
+				Timer* timer = _expired[i];
+				due.push_back(std::make_pair(timer->task, timer->op));
+				if (timer->period > 0)
+				{
+					_firing.push_back(timer->id);
+					// Runs that were missed are skipped rather than bunched up
+					timer->deadline += timer->period;
+					if (timer->deadline <= _currentTick)
+						timer->deadline += ((_currentTick - timer->deadline) / timer->period + 1) * timer->period;
+					insert(timer);
+				}
+				else
+				{
+					_timers.erase(timer->id);
+					release(timer);
+				}
+			}
+			_expired.clear();
+
+			{
+				ReverseScopedLock<Mutex> sunlock(_mutex);
+				for (size_t i = 0; i < due.size(); ++i)
+					_pool->submit(due[i].first, due[i].second);
+			}
+			due.clear();
+			if (!_firing.empty())
+			{
+				_firing.clear();
+				_fired.broadcast();
+			}
+			continue;
+		}
+
+		_wakeTick = nextWakeTick();
+		if (_wakeTick == NEVER)
+			_condition.wait(&_mutex);
+		else
+		{
+			unsigned long long wakeUs = _wakeTick * TICK_US, nowUs = now();
+			if (wakeUs > nowUs)
+			{
+				unsigned long long waitUs = wakeUs - nowUs;
+				if (waitUs >= MIN_CONDITION_WAIT_US)
+					_condition.wait(&_mutex, (unsigned long)(waitUs / 1000 - 1));
+				else
+				{
+					ReverseScopedLock<Mutex> sunlock(_mutex);
+					Thread::microSleep((unsigned int)waitUs);
+				}
+			}
+		}
+		_wakeTick = NEVER;
+	}
+}
+
+void TimerWheel::insert(Timer* timer)
+{
+	unsigned long long delta = timer->deadline - _currentTick;
+	assert(timer->deadline > _currentTick);
+
+	unsigned int level = 0;
+	while (level < LEVELS - 1 && delta >= (1ULL << ((level + 1) * SLOT_BITS)))
+		++level;
+
+	// Beyond the range of the wheel, park the timer in the farthest slot;
+	// it is placed again, with its actual deadline, when that slot cascades.
+	unsigned long long at = timer->deadline;
+	if (delta >= (1ULL << (LEVELS * SLOT_BITS)))
+		at = _currentTick + (1ULL << (LEVELS * SLOT_BITS)) - 1;
+
+	Timer** slot = &_slots[level][(at >> (level * SLOT_BITS)) & SLOT_MASK];
+	timer->next = *slot;
+	if (timer->next)
+		timer->next->pprev = &timer->next;
+	timer->pprev = slot;
+	*slot = timer;
+}
+
+void TimerWheel::unlink(Timer* timer)
+{
+	*timer->pprev = timer->next;
+	if (timer->next)
+		timer->next->pprev = timer->pprev;
+	timer->next = nullptr;
+	timer->pprev = nullptr;
+}
+
+void TimerWheel::advance(unsigned long long tick)
+{
+	while (_currentTick < tick)
+	{
+		if (_timers.empty())
+		{
+			_currentTick = tick;
+			return;
+		}
+
+		++_currentTick;
+
+		// At the start of a turn of level n-1, spread the next slot of level n
+		for (unsigned int level = 1; level < LEVELS; ++level)
+		{
+			if ((_currentTick & ((1ULL << (level * SLOT_BITS)) - 1)) != 0)
+				break;
+			cascade(level, (unsigned int)(_currentTick >> (level * SLOT_BITS)) & SLOT_MASK);
+		}
+
+		Timer** slot = &_slots[0][_currentTick & SLOT_MASK];
+		while (*slot)
+		{
+			Timer* timer = *slot;
+			unlink(timer);
+			assert(timer->deadline <= _currentTick);
+			_expired.push_back(timer);
+		}
+	}
+}
+
+void TimerWheel::cascade(unsigned int level, unsigned int slot)
+{
+	Timer* timer = _slots[level][slot];
+	_slots[level][slot] = nullptr;
+	while (timer)
+	{
+		Timer* next = timer->next;
+		// The slot spans the current tick too
+		if (timer->deadline <= _currentTick)
+			_expired.push_back(timer);
+		else
+			insert(timer);
+		timer = next;
+	}
+}
+
+unsigned long long TimerWheel::nextWakeTick() const
+{
+	if (_timers.empty())
+		return NEVER;
+
+	// The next occupied slot of level 0, or the end of its turn, where the
+	// next cascade takes place.
+	unsigned long long tick = _currentTick + 1;
+	while ((tick & SLOT_MASK) != 0 && !_slots[0][tick & SLOT_MASK])
+		++tick;
+	return tick;
+}
+
+TimerWheel::Timer* TimerWheel::allocate()
+{
+	if (_free.empty())
+		return new Timer;
+	Timer* timer = _free.back();
+	_free.pop_back();
+	return timer;
+}
+
+void TimerWheel::release(Timer* timer)
+{
+	_free.push_back(timer);
+}
@@ -0,0 +1,114 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+
+//
+// TimerWheel - Delayed tasks of a ThreadPool (private to the library)
+// ~~~~~~~~~~
+//
+
+#ifndef _OPENTHREADS_TIMERWHEEL_
+#define _OPENTHREADS_TIMERWHEEL_
+
+#include <OpenThreads/ThreadPool>
+#include <unordered_map>
+#include <vector>
+
+namespace OpenThreads {
+
+// The pending timers of a ThreadPool, in a hierarchical timing wheel
+// (Varghese & Lauck) serviced by a thread of its own. Level 0 has one slot per
+// tick; each slot of level n covers a whole turn of level n-1 and is spread
+// over level n-1 when that turn begins. Adding and cancelling a timer are
+// O(1) and each timer is moved at most LEVELS - 1 times, so tens of thousands
+// of pending timers cost no more per tick than a handful.
+// The thread sleeps until the next occupied slot of level 0, or until the
+// next cascade, and not at all while no timer is pending.
+class TimerWheel : public Thread
+{
+public:
+	typedef ThreadPool::TimerId TimerId;
+
+	TimerWheel(ThreadPool* pool);
+	virtual ~TimerWheel();
+
+	// Returns 0 once shutdown() has been called. A periodUs of 0 makes a
+	// one-shot timer.
+	TimerId add(Task* task, ThreadPool::DispatchOp* op, unsigned long long delayUs, unsigned long long periodUs);
+
+	// Waits for a repeating timer that is being submitted, unless called
+	// from the timer thread.
+	bool cancel(TimerId id);
+
+	// Stop the thread and drop the pending timers. A timer that fires
+	// concurrently is submitted before this returns.
+	void shutdown();
+
+	size_t getPendingCount();
+
+	virtual void run();
+
+private:
+	enum
+	{
+		LEVELS		= 4,
+		SLOT_BITS	= 6,
+		SLOTS		= 1 << SLOT_BITS,
+		SLOT_MASK	= SLOTS - 1,
+	};
+
+	struct Timer
+	{
+		TimerId id;
+		Task* task;
+		ThreadPool::DispatchOp* op;
+		unsigned long long deadline;	// in ticks
+		unsigned long long period;		// in ticks, 0 for a one-shot timer
+		Timer* next;
+		Timer** pprev;
+	};
+
+	unsigned long long now() const;
+	unsigned long long toTicks(unsigned long long us) const;
+
+	void insert(Timer* timer);
+	static void unlink(Timer* timer);
+	void advance(unsigned long long tick);
+	void cascade(unsigned int level, unsigned int slot);
+	unsigned long long nextWakeTick() const;
+
+	Timer* allocate();
+	void release(Timer* timer);
+
+	ThreadPool* _pool;
+	Mutex _mutex;
+	Condition _condition;
+	bool _running;
+	// The timers being submitted with the lock released, and the condition
+	// cancel() waits on until they are
+	std::vector<TimerId> _firing;
+	Condition _fired;
+
+	Timer* _slots[LEVELS][SLOTS];
+	std::unordered_map<TimerId, Timer*> _timers;
+	std::vector<Timer*> _expired;
+	std::vector<Timer*> _free;
+	unsigned long long _currentTick;
+	// Tick the thread sleeps until, or ~0 while it waits for a timer
+	unsigned long long _wakeTick;
+	TimerId _nextId;
+};
+
+}
+
+#endif // !_OPENTHREADS_TIMERWHEEL_
@@ -0,0 +1,118 @@
+/* -*-c++-*- OpenThreads library, Copyright (C) 2002 - 2007  The Open Thread Group
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+
+//
+// WorkStealingDeque - Spawned frames of a WorkerThread (private to the library)
+// ~~~~~~~~~~~~~~~~~
+//
+
+#ifndef _OPENTHREADS_WORKSTEALINGDEQUE_
+#define _OPENTHREADS_WORKSTEALINGDEQUE_
+
+#include <OpenThreads/Backoff>
+#include <atomic>
+#include <vector>
+
+namespace OpenThreads {
+
+class ForkJoinFrame;
+
+// A bounded Chase-Lev deque (Chase & Lev, with the memory orders of Le et
+// al.): the worker owning it pushes and pops at the bottom without a lock or
+// a read-modify-write, except when taking the last frame; other workers
+// steal the oldest frame from the top with a compare-and-swap. The slots are
+// allocated once, with the worker, so pushing never allocates; push() fails
+// when the deque is full and the caller then runs the frame itself.
+class WorkStealingDeque
+{
+public:
+	enum { CAPACITY = 4096 };
+
+	WorkStealingDeque() : _slots(CAPACITY), _top(0), _bottom(0)
+	{
+		for (size_t i = 0; i < _slots.size(); ++i)
+			_slots[i].store(nullptr, std::memory_order_relaxed);
+	}
+
+	// Owner only
+	bool push(ForkJoinFrame* frame)
+	{
+		long long b = _bottom.load(std::memory_order_relaxed);
+		long long t = _top.load(std::memory_order_acquire);
+		if (b - t >= CAPACITY)
+			return false;
+		_slots[b & (CAPACITY - 1)].store(frame, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		_bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Owner only. Returns the newest frame, or nullptr if the deque is empty
+	// or a thief took the last frame.
+	ForkJoinFrame* pop()
+	{
+		long long b = _bottom.load(std::memory_order_relaxed) - 1;
+		_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long t = _top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			_bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		ForkJoinFrame* frame = _slots[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// The last frame: race the thieves for it
+			if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				frame = nullptr;
+			_bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return frame;
+	}
+
+	// Any thread. Returns the oldest frame, or nullptr if the deque is empty
+	// or another thread took it first.
+	ForkJoinFrame* steal()
+	{
+		long long t = _top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long b = _bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return nullptr;
+
+		ForkJoinFrame* frame = _slots[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return frame;
+	}
+
+	bool looksEmpty() const
+	{
+		return _bottom.load(std::memory_order_relaxed) <= _top.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::vector<std::atomic<ForkJoinFrame*> > _slots;
+	// Thieves and the owner write different ends
+	char _pad0[OPENTHREADS_CACHE_LINE_SIZE];
+	std::atomic<long long> _top;
+	char _pad1[OPENTHREADS_CACHE_LINE_SIZE];
+	std::atomic<long long> _bottom;
+};
+
+}
+
+#endif // !_OPENTHREADS_WORKSTEALINGDEQUE_
@@ -196,6 +196,32 @@ private:
 
 #endif // ] ALLOW_PRIORITY_SCHEDULING
 
+        //---------------------------------------------------------------------
+        // Apply the run-time real-time settings, over the ones above, and
+        // the stack options, and record what was granted before start()
+        // returns.
+        //
+        pd->realTimeResult = RealTimeResult();
+        if (pd->realTime.policy != RealTimeSettings::POLICY_UNCHANGED ||
+            pd->realTime.lockMemory || pd->realTime.prefaultStack > 0)
+        {
+            SetRealTimeOfCurrentThread(pd->realTime, &pd->realTimeResult);
+        }
+
+        if (pd->stackPrefault)
+        {
+            size_t prefaulted = PrefaultStackOfCurrentThread(pd->stackSize);
+            if (prefaulted > pd->realTimeResult.prefaulted)
+                pd->realTimeResult.prefaulted = prefaulted;
+        }
+
+        if (pd->stackLock)
+        {
+            int lockStatus = LockStackOfCurrentThread();
+            if (pd->realTimeResult.memoryLockError == 0)
+                pd->realTimeResult.memoryLockError = lockStatus;
+        }
+
         pd->setRunning(true);
 
         // release the thread that created this thread.
@@ -425,6 +451,11 @@ Thread::Thread()
     PThreadPrivateData *pd = new PThreadPrivateData();
     pd->stackSize = 0;
     pd->stackSizeLocked = false;
+    pd->stackMemory = 0;
+    pd->stackGuardSize = 0;
+    pd->stackGuardSizeSet = false;
+    pd->stackPrefault = false;
+    pd->stackLock = false;
     pd->idSet = false;
     pd->setRunning(false);
     pd->isCanceled = false;
@@ -648,10 +679,18 @@ int Thread::start() {
     PThreadPrivateData *pd = static_cast<PThreadPrivateData *> (_prvData);
 
     //-------------------------------------------------------------------------
-    // Set the stack size if requested, but not less than a platform reasonable
-    // value.
+    // Run on the caller's stack memory if given, else set the stack size if
+    // requested, but not less than a platform reasonable value.
     //
-    if(pd->stackSize)
+    if(pd->stackMemory)
+    {
+        status = pthread_attr_setstack( &thread_attr, pd->stackMemory, pd->stackSize);
+        if(status != 0)
+        {
+            return status;
+        }
+    }
+    else if(pd->stackSize)
     {
 #ifdef PTHREAD_STACK_MIN
         if(pd->stackSize < PTHREAD_STACK_MIN)
@@ -664,6 +703,18 @@ int Thread::start() {
         }
     }
 
+    //-------------------------------------------------------------------------
+    // Set the guard size if requested; ignored on the caller's stack memory.
+    //
+    if(pd->stackGuardSizeSet)
+    {
+        status = pthread_attr_setguardsize( &thread_attr, pd->stackGuardSize);
+        if(status != 0)
+        {
+            return status;
+        }
+    }
+
     //-------------------------------------------------------------------------
     // Now get what we actually have...
     //
@@ -938,6 +989,9 @@ int Thread::setStackSize(size_t stackSize) {
 
     if(pd->stackSizeLocked == true) return 13;  // EACESS
 
+    // The size of the caller's memory is set along with it
+    if(pd->stackMemory) return 13;  // EACESS
+
     pd->stackSize = stackSize;
 
     return 0;
@@ -959,6 +1013,152 @@ size_t Thread::getStackSize()
 
 }
 
+//-----------------------------------------------------------------------------
+//
+// Description: Set the caller's memory the thread's stack lives in.
+//
+// Use: public
+//
+int Thread::setStackMemory(void* stack, size_t size) {
+
+    PThreadPrivateData *pd = static_cast<PThreadPrivateData *> (_prvData);
+
+    if(pd->isRunning()) return 13;  // EACESS
+
+    pd->stackMemory = stack;
+    pd->stackSize = stack ? size : 0;
+
+    return 0;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get the caller's memory the thread's stack lives in.
+//
+// Use: public
+//
+void* Thread::getStackMemory()
+{
+
+    PThreadPrivateData *pd = static_cast<PThreadPrivateData *> (_prvData);
+
+    return pd->stackMemory;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Set the thread's stack guard size.
+//
+// Use: public
+//
+int Thread::setStackGuardSize(size_t size) {
+
+    PThreadPrivateData *pd = static_cast<PThreadPrivateData *> (_prvData);
+
+    if(pd->isRunning()) return 13;  // EACESS
+
+    pd->stackGuardSize = size;
+    pd->stackGuardSizeSet = true;
+
+    return 0;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get the thread's stack guard size.
+//
+// Use: public
+//
+size_t Thread::getStackGuardSize()
+{
+
+    PThreadPrivateData *pd = static_cast<PThreadPrivateData *> (_prvData);
+
+    if(pd->stackGuardSizeSet)
+        return pd->stackGuardSize;
+
+    size_t size = 0;
+    pthread_attr_t thread_attr;
+    if(pthread_attr_init( &thread_attr ) == 0)
+    {
+        pthread_attr_getguardsize( &thread_attr, &size);
+        pthread_attr_destroy( &thread_attr );
+    }
+    return size;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Set whether the thread prefaults and locks its stack.
+//
+// Use: public
+//
+int Thread::setStackPrefault(bool prefault, bool lock) {
+
+    PThreadPrivateData *pd = static_cast<PThreadPrivateData *> (_prvData);
+
+    if(pd->isRunning()) return 13;  // EACESS
+
+    pd->stackPrefault = prefault;
+    pd->stackLock = lock;
+
+    return 0;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Set the real-time settings applied when the thread starts.
+//
+// Use: public
+//
+int Thread::setRealTime(const RealTimeSettings& settings)
+{
+
+    PThreadPrivateData *pd = static_cast<PThreadPrivateData *> (_prvData);
+
+    if(pd->isRunning()) return 13;  // EACESS
+
+    pd->realTime = settings;
+
+    return 0;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get the real-time settings applied when the thread starts.
+//
+// Use: public
+//
+const RealTimeSettings& Thread::getRealTime() const
+{
+
+    PThreadPrivateData *pd = static_cast<PThreadPrivateData *> (_prvData);
+
+    return pd->realTime;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get what was granted of the real-time settings.
+//
+// Use: public
+//
+const RealTimeResult& Thread::getRealTimeResult() const
+{
+
+    PThreadPrivateData *pd = static_cast<PThreadPrivateData *> (_prvData);
+
+    return pd->realTimeResult;
+
+}
+
 //-----------------------------------------------------------------------------
 //
 // Description:  Print the thread's scheduling information to stdout.
@@ -23,6 +23,7 @@
 #  include <sys/time.h>
 #endif
 
+#include <errno.h>
 #include <stdio.h>
 
 #include <OpenThreads/Condition>
@@ -127,6 +128,14 @@ int Condition::wait(Mutex *mutex) {
     PThreadConditionPrivateData *pd =
         static_cast<PThreadConditionPrivateData *>(_prvData);
 
+    // A fiber gives its thread back while it waits
+    SuspendableFiber *fiber = SuspendableFiber::current();
+    if (fiber)
+    {
+        pd->fibers.wait(fiber, mutex, FiberWaitList::FOREVER);
+        return 0;
+    }
+
     PThreadMutexPrivateData *mpd =
         static_cast<PThreadMutexPrivateData *>(mutex->_prvData);
 
@@ -154,6 +163,14 @@ int Condition::wait(Mutex *mutex, unsigned long int ms) {
     PThreadConditionPrivateData *pd =
         static_cast<PThreadConditionPrivateData *>(_prvData);
 
+    SuspendableFiber *fiber = SuspendableFiber::current();
+    if (fiber)
+    {
+        FiberWaitList::Result result = pd->fibers.wait(fiber, mutex, ms);
+        if (result != FiberWaitList::NO_TIMER)
+            return result == FiberWaitList::TIMED_OUT ? ETIMEDOUT : 0;
+    }
+
     PThreadMutexPrivateData *mpd =
         static_cast<PThreadMutexPrivateData *>(mutex->_prvData);
 
@@ -200,6 +217,9 @@ int Condition::signal() {
     PThreadConditionPrivateData *pd =
         static_cast<PThreadConditionPrivateData *>(_prvData);
 
+    if (pd->fibers.signal())
+        return 0;
+
     return pthread_cond_signal( &pd->condition );
 }
 
@@ -214,5 +234,7 @@ int Condition::broadcast() {
     PThreadConditionPrivateData *pd =
         static_cast<PThreadConditionPrivateData *>(_prvData);
 
+    pd->fibers.broadcast();
+
     return pthread_cond_broadcast( &pd->condition );
 }
@@ -22,6 +22,7 @@
 
 #include <pthread.h>
 #include <OpenThreads/Condition>
+#include "../common/FiberWaitList.h"
 
 namespace OpenThreads {
 
@@ -37,6 +38,8 @@ private:
 
     pthread_cond_t condition;
 
+    FiberWaitList fibers;
+
 };
 
 }
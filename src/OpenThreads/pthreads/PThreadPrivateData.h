@@ -49,6 +49,16 @@ private:
 
     volatile bool stackSizeLocked;
 
+    void* stackMemory;
+
+    size_t stackGuardSize;
+
+    bool stackGuardSizeSet;
+
+    bool stackPrefault;
+
+    bool stackLock;
+
     void setRunning(bool flag) { _isRunning.exchange(flag); }
     bool isRunning() const { return _isRunning!=0; }
 
@@ -70,6 +80,10 @@ private:
 
     volatile int cpunum;
 
+    RealTimeSettings realTime;
+
+    RealTimeResult realTimeResult;
+
 
     static int nextId;
 
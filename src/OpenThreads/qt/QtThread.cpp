@@ -17,6 +17,7 @@
 
 #include "QtThreadPrivateData.h"
 #include <QCoreApplication>
+#include <errno.h>
 #include <iostream>
 
 using namespace OpenThreads;
@@ -365,6 +366,102 @@ size_t Thread::getStackSize()
     return pd->stackSize;
 }
 
+//-----------------------------------------------------------------------------
+//
+// Description: Set the caller's memory the thread's stack lives in.
+//              QThread always allocates the stack itself.
+//
+// Use: public
+//
+int Thread::setStackMemory(void* stack, size_t)
+{
+    return stack ? ENOSYS : 0;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get the caller's memory the thread's stack lives in.
+//
+// Use: public
+//
+void* Thread::getStackMemory()
+{
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Set the thread's stack guard size. QThread has no control
+//              over the guard.
+//
+// Use: public
+//
+int Thread::setStackGuardSize(size_t)
+{
+    return ENOSYS;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get the thread's stack guard size, unknown to QThread.
+//
+// Use: public
+//
+size_t Thread::getStackGuardSize()
+{
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Set whether the thread prefaults and locks its stack (not
+//              supported).
+//
+// Use: public
+//
+int Thread::setStackPrefault(bool prefault, bool lock)
+{
+    return prefault || lock ? ENOSYS : 0;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Set the real-time settings applied when the thread starts.
+//
+// Use: public
+//
+int Thread::setRealTime(const RealTimeSettings& settings)
+{
+    QtThreadPrivateData* pd = static_cast<QtThreadPrivateData*>(_prvData);
+    if (pd->isRunning) return 13;  // return EACESS
+    pd->realTime = settings;
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get the real-time settings applied when the thread starts.
+//
+// Use: public
+//
+const RealTimeSettings& Thread::getRealTime() const
+{
+    QtThreadPrivateData* pd = static_cast<QtThreadPrivateData*>(_prvData);
+    return pd->realTime;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get what was granted of the real-time settings.
+//
+// Use: public
+//
+const RealTimeResult& Thread::getRealTimeResult() const
+{
+    QtThreadPrivateData* pd = static_cast<QtThreadPrivateData*>(_prvData);
+    return pd->realTimeResult;
+}
+
 //-----------------------------------------------------------------------------
 //
 // Description:  set processor affinity for the thread
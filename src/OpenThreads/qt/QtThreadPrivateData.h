@@ -22,6 +22,7 @@
 #include <OpenThreads/Thread>
 #include <OpenThreads/Block>
 #include <QThread>
+#include <errno.h>
 
 struct QtThreadCanceled {};
 
@@ -75,9 +76,21 @@ public:
         setPriority( prio );
     }
     
+    // QThread has no run-time real-time scheduling: report what was asked
+    // for as refused
+    void applyRealTime()
+    {
+        realTimeResult = OpenThreads::RealTimeResult();
+        if (realTime.policy != OpenThreads::RealTimeSettings::POLICY_UNCHANGED)
+            realTimeResult.schedulingError = ENOSYS;
+        if (realTime.lockMemory)
+            realTimeResult.memoryLockError = ENOSYS;
+    }
+    
     virtual void run()
     {
         applyPriority();
+        applyRealTime();
         isRunning = true;
         threadStartedBlock.release();
         
@@ -108,6 +121,9 @@ public:
     bool detached;
     bool isRunning;
     
+    OpenThreads::RealTimeSettings realTime;
+    OpenThreads::RealTimeResult realTimeResult;
+    
     OpenThreads::Block threadStartedBlock;
     
 private:
@@ -25,6 +25,7 @@
 #include <sys/sysmp.h>
 #include <signal.h>
 #include <unistd.h>
+#include <errno.h>
 #include <list>
 #include <OpenThreads/Thread>
 #include "SprocMutexPrivateData.h"
@@ -155,6 +156,16 @@ void ThreadPrivateActions::StartThread(void *data)
 
     pd->stackSizeLocked = true;
 
+    //---------------------------------------------------------------------
+    // sproc has no run-time real-time scheduling: report what was asked
+    // for as refused before start() returns.
+    //
+    pd->realTimeResult = RealTimeResult();
+    if(pd->realTime.policy != RealTimeSettings::POLICY_UNCHANGED)
+	pd->realTimeResult.schedulingError = ENOSYS;
+    if(pd->realTime.lockMemory)
+	pd->realTimeResult.memoryLockError = ENOSYS;
+
     pd->isRunning = true;
 
     // release the thread that created this thread.
@@ -740,6 +751,117 @@ size_t Thread::getStackSize() {
 
 }
 
+//-----------------------------------------------------------------------------
+//
+// Description: Set the caller's memory the thread's stack lives in.
+//              sproc() always allocates the stack itself.
+//
+// Use: public
+//
+int Thread::setStackMemory(void* stack, size_t) {
+
+    return stack ? ENOSYS : 0;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get the caller's memory the thread's stack lives in.
+//
+// Use: public
+//
+void* Thread::getStackMemory() {
+
+    return 0;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Set the thread's stack guard size (not supported).
+//
+// Use: public
+//
+int Thread::setStackGuardSize(size_t) {
+
+    return ENOSYS;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get the thread's stack guard size (not supported).
+//
+// Use: public
+//
+size_t Thread::getStackGuardSize() {
+
+    return 0;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Set whether the thread prefaults and locks its stack (not
+//              supported).
+//
+// Use: public
+//
+int Thread::setStackPrefault(bool prefault, bool lock) {
+
+    return prefault || lock ? ENOSYS : 0;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Set the real-time settings applied when the thread starts.
+//
+// Use: public
+//
+int Thread::setRealTime(const RealTimeSettings& settings) {
+
+    SprocThreadPrivateData *pd =
+	static_cast<SprocThreadPrivateData *> (_prvData);
+
+    if(pd->isRunning) return 13;  // EACESS
+
+    pd->realTime = settings;
+
+    return 0;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get the real-time settings applied when the thread starts.
+//
+// Use: public
+//
+const RealTimeSettings& Thread::getRealTime() const {
+
+    SprocThreadPrivateData *pd =
+	static_cast<SprocThreadPrivateData *> (_prvData);
+
+    return pd->realTime;
+
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get what was granted of the real-time settings.
+//
+// Use: public
+//
+const RealTimeResult& Thread::getRealTimeResult() const {
+
+    SprocThreadPrivateData *pd =
+	static_cast<SprocThreadPrivateData *> (_prvData);
+
+    return pd->realTimeResult;
+
+}
+
 //-----------------------------------------------------------------------------
 //
 // Description:  Print the thread's scheduling information to stdout.
@@ -69,6 +69,10 @@ private:
     
     volatile Thread::ThreadPolicy threadPolicy;
 
+    RealTimeSettings realTime;
+
+    RealTimeResult realTimeResult;
+
     volatile pid_t pid;
 
     volatile int uniqueId;
@@ -59,6 +59,14 @@ int Condition::wait(Mutex *mutex) {
     Win32ConditionPrivateData *pd =
         static_cast<Win32ConditionPrivateData *>(_prvData);
 
+    // A fiber gives its thread back while it waits
+    SuspendableFiber *fiber = SuspendableFiber::current();
+    if (fiber)
+    {
+        pd->fibers.wait(fiber, mutex, FiberWaitList::FOREVER);
+        return 0;
+    }
+
     return pd->wait(*mutex, INFINITE);
 }
 //----------------------------------------------------------------------------
@@ -72,6 +80,14 @@ int Condition::wait(Mutex *mutex, unsigned long ms) {
     Win32ConditionPrivateData *pd =
         static_cast<Win32ConditionPrivateData *>(_prvData);
 
+    SuspendableFiber *fiber = SuspendableFiber::current();
+    if (fiber)
+    {
+        FiberWaitList::Result result = pd->fibers.wait(fiber, mutex, ms);
+        if (result != FiberWaitList::NO_TIMER)
+            return result == FiberWaitList::TIMED_OUT ? (int)WAIT_TIMEOUT : 0;
+    }
+
     return pd->wait(*mutex, ms);
 }
 //----------------------------------------------------------------------------
@@ -84,6 +100,8 @@ int Condition::signal() {
 
     Win32ConditionPrivateData *pd =
         static_cast<Win32ConditionPrivateData *>(_prvData);
+    if (pd->fibers.signal())
+        return 0;
     return pd->signal();
 }
 //----------------------------------------------------------------------------
@@ -96,5 +114,6 @@ int Condition::broadcast() {
 
     Win32ConditionPrivateData *pd =
         static_cast<Win32ConditionPrivateData *>(_prvData);
+    pd->fibers.broadcast();
     return pd->broadcast();
 }
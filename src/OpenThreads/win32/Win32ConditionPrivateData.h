@@ -23,6 +23,7 @@
 
 #include "Win32ThreadPrivateData.h"
 #include "HandleHolder.h"
+#include "../common/FiberWaitList.h"
 
 #define InterlockedGet(x) InterlockedExchangeAdd(x,0)
 
@@ -139,6 +140,10 @@ protected:
   HandleHolder waiters_done_;
   /// Keeps track of whether we were broadcasting or just signaling.
   size_t was_broadcast_;
+
+public:
+  /// Fibers waiting, which do not block their thread.
+  FiberWaitList fibers;
 };
 
 #undef InterlockedGet
@@ -20,6 +20,7 @@
 #include <iostream>
 #include <process.h>
 #include <stdlib.h>
+#include <errno.h>
 
 #if defined(_MSC_VER) && (_MSC_VER < 1300)
 #ifdef __SGI_STL
@@ -101,6 +102,31 @@ namespace OpenThreads {
             //
             SetThreadSchedulingParams(thread);
 
+            //---------------------------------------------------------------------
+            // Apply the run-time real-time settings and the stack options,
+            // and record what was granted before start() returns.
+            //
+            pd->realTimeResult = RealTimeResult();
+            if (pd->realTime.policy != RealTimeSettings::POLICY_UNCHANGED ||
+                pd->realTime.lockMemory || pd->realTime.prefaultStack > 0)
+            {
+                SetRealTimeOfCurrentThread(pd->realTime, &pd->realTimeResult);
+            }
+
+            if (pd->stackPrefault)
+            {
+                size_t prefaulted = PrefaultStackOfCurrentThread(pd->stackSize ? pd->stackSize : (size_t)-1);
+                if (prefaulted > pd->realTimeResult.prefaulted)
+                    pd->realTimeResult.prefaulted = prefaulted;
+            }
+
+            if (pd->stackLock)
+            {
+                int lockStatus = LockStackOfCurrentThread();
+                if (pd->realTimeResult.memoryLockError == 0)
+                    pd->realTimeResult.memoryLockError = lockStatus;
+            }
+
             pd->isRunning = true;
 
             // release the thread that created this thread.
@@ -234,6 +260,8 @@ int Thread::GetConcurrency() {
 Win32ThreadPrivateData::Win32ThreadPrivateData()
 {
     stackSize = 0;
+    stackPrefault = false;
+    stackLock = false;
     isRunning = false;
     cancelMode = 0;
     uniqueId = 0;
@@ -569,6 +597,101 @@ size_t Thread::getStackSize() {
     return pd->stackSize;
 }
 
+//-----------------------------------------------------------------------------
+//
+// Description: Set the caller's memory the thread's stack lives in.
+//              _beginthreadex() always allocates the stack itself.
+//
+// Use: public
+//
+int Thread::setStackMemory(void* stack, size_t) {
+    return stack ? ENOSYS : 0;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get the caller's memory the thread's stack lives in.
+//
+// Use: public
+//
+void* Thread::getStackMemory() {
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Set the thread's stack guard size. Windows grows stacks
+//              behind guard pages of its own, which cannot be resized
+//              or removed.
+//
+// Use: public
+//
+int Thread::setStackGuardSize(size_t) {
+    return ENOSYS;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get the thread's stack guard size: the guard page
+//              Windows keeps below the committed part of a stack.
+//
+// Use: public
+//
+size_t Thread::getStackGuardSize() {
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    return sysInfo.dwPageSize;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Set whether the thread prefaults and locks its stack.
+//
+// Use: public
+//
+int Thread::setStackPrefault(bool prefault, bool lock) {
+    Win32ThreadPrivateData *pd = static_cast<Win32ThreadPrivateData *> (_prvData);
+    if(pd->isRunning) return 13;  // EACESS
+    pd->stackPrefault = prefault;
+    pd->stackLock = lock;
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Set the real-time settings applied when the thread starts.
+//
+// Use: public
+//
+int Thread::setRealTime(const RealTimeSettings& settings) {
+    Win32ThreadPrivateData *pd = static_cast<Win32ThreadPrivateData *> (_prvData);
+    if(pd->isRunning) return 13;  // EACESS
+    pd->realTime = settings;
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get the real-time settings applied when the thread starts.
+//
+// Use: public
+//
+const RealTimeSettings& Thread::getRealTime() const {
+    Win32ThreadPrivateData *pd = static_cast<Win32ThreadPrivateData *> (_prvData);
+    return pd->realTime;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Description: Get what was granted of the real-time settings.
+//
+// Use: public
+//
+const RealTimeResult& Thread::getRealTimeResult() const {
+    Win32ThreadPrivateData *pd = static_cast<Win32ThreadPrivateData *> (_prvData);
+    return pd->realTimeResult;
+}
+
 //-----------------------------------------------------------------------------
 //
 // Description:  set processor affinity for the thread
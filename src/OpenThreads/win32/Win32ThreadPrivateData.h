@@ -40,6 +40,8 @@ private:
     ~Win32ThreadPrivateData();
 
     size_t stackSize;
+    bool stackPrefault;
+    bool stackLock;
     bool isRunning;
 
     Block threadStartedBlock;
@@ -58,6 +60,10 @@ private:
 
     int cpunum;
 
+    RealTimeSettings realTime;
+
+    RealTimeResult realTimeResult;
+
 public:
 
     HandleHolder cancelEvent;